@@ -1,73 +1,256 @@
 #include "crosswords.h"
 #include <algorithm>
 #include <cctype>
+#include <charconv>
 #include <compare>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
 #include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
 #include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Runs f(first, last) over consecutive slices of [0, count) on the given
+// number of threads.
+template <typename F> void parallel_for(size_t count, size_t threads, F &&f) {
+    std::vector<std::thread> workers;
+    size_t slice = (count + threads - 1) / threads;
+    for (size_t first = slice; first < count; first += slice)
+        workers.emplace_back(f, first, std::min(count, first + slice));
+    f(0, std::min(count, slice));
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+bool overlap(const RectArea &r1, const RectArea &r2) {
+    return !(r1 * r2).empty();
+}
+
+// Upper-cases ASCII letters the way ::toupper does in the C locale.
+void upper_case(char *first, char *last) {
+    for (; first != last; ++first)
+        *first -= (*first >= 'a' && *first <= 'z') * ('a' - 'A');
+}
+
+constexpr size_t IMPORT_CHUNK = 1 << 16;
+
+// A row of background cells between the borders, as operator<< draws it.
+void blank_row(char *row, size_t row_size) {
+    for (size_t i = 0; i < row_size; i++)
+        row[i] = i % 2 == 0 ? CROSSWORD_BACKGROUND : ' ';
+    row[row_size - 1] = '\n';
+}
+
+// Words at least this long are checked for collisions a tile line at a time.
+constexpr size_t LINE_CHECK_LENGTH = 8;
+
+// Whether the letters of a word collide with the cells of the line under
+// them, or the lines on either side, in any lane set in lanes: a letter
+// must match the one in its cell, and an empty cell may have no letters
+// beside it. Empty cells and lanes of the word are '\0'.
+bool lanes_collide(const char *letters, const char *line, const char *before,
+                   const char *after, uint32_t lanes) {
+#if defined(__SSE2__)
+    auto load = [](const char *cells) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(cells));
+    };
+    // Lanes holding ASCII letters of either case.
+    auto is_letter = [](__m128i c) {
+        __m128i offset = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)),
+                                      _mm_set1_epi8('a'));
+        return _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(25)), offset);
+    };
+    __m128i zero = _mm_setzero_si128();
+    __m128i w = load(letters), cell = load(line);
+    __m128i letter_w = is_letter(w), letter_cell = is_letter(cell);
+    __m128i both_letters = _mm_and_si128(letter_w, letter_cell);
+    __m128i same = _mm_or_si128(
+        _mm_and_si128(both_letters, _mm_cmpeq_epi8(w, cell)),
+        _mm_cmpeq_epi8(_mm_or_si128(letter_w, letter_cell), zero));
+    __m128i empty = _mm_cmpeq_epi8(cell, zero);
+    __m128i sides_empty =
+        _mm_cmpeq_epi8(_mm_or_si128(load(before), load(after)), zero);
+    __m128i mismatch = _mm_andnot_si128(empty, _mm_cmpeq_epi8(same, zero));
+    __m128i crowded = _mm_andnot_si128(sides_empty, empty);
+    __m128i collides = _mm_or_si128(mismatch, crowded);
+    return (_mm_movemask_epi8(collides) & lanes) != 0;
+#else
+    for (size_t i = 0; lanes != 0; i++, lanes >>= 1) {
+        if (!(lanes & 1))
+            continue;
+        if (line[i] != '\0' ? !Word::are_letters_the_same(line[i], letters[i])
+                            : before[i] != '\0' || after[i] != '\0')
+            return true;
+    }
+    return false;
+#endif
+}
+
+#ifdef CROSSWORDS_STATS
+// Bytes taken from the heap by word stores on this thread.
+thread_local uint64_t store_bytes = 0;
 
-#define FIND_CLOSEST_WORD_AND_RETURN(word_set, to)                             \
-    {                                                                          \
-        auto it = (word_set)->upper_bound(&to);                                \
-        if (it != (word_set)->begin())                                         \
-            it--;                                                              \
-        if (it == (word_set)->end())                                           \
-            return {};                                                         \
-        return *it;                                                            \
+class CountingResource : public std::pmr::memory_resource {
+    void *do_allocate(size_t bytes, size_t alignment) override {
+        store_bytes += bytes;
+        return std::pmr::get_default_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+        std::pmr::get_default_resource()->deallocate(p, bytes, alignment);
     }
+    bool do_is_equal(const memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+#endif
+
+// Where word stores get their blocks from.
+std::pmr::memory_resource *store_upstream() {
+#ifdef CROSSWORDS_STATS
+    static CountingResource counting;
+    return &counting;
+#else
+    return std::pmr::get_default_resource();
+#endif
+}
+
+// Adds by to the words counted at an edge, dropping the edge at zero.
+void count_edge(WordStore::edge_count_t &edge, cord_t at, ptrdiff_t by) {
+    auto it = edge.try_emplace(at, 0).first;
+    it->second += by;
+    if (it->second == 0)
+        edge.erase(it);
+}
+
+// The store left to moved-from crosswords. It is owned by none, which tells
+// make_writable to replace it, so it is never written and taking it never
+// allocates.
+const std::shared_ptr<WordStore> &empty_store() noexcept {
+    static WordStore empty;
+    static const std::shared_ptr<WordStore> unowned(std::shared_ptr<void>(),
+                                                    &empty);
+    return unowned;
+}
+} // namespace
 
-const RectArea DEFAULT_EMPTY_RECT_AREA = RectArea({1, 1}, {0, 0});
 char CROSSWORD_BACKGROUND = '.';
 
 // Word implementation:
 
 Word::Word(size_t x, size_t y, orientation_t wordOrientation,
            std::string &&wordContent)
-    : wordStart({x, y}), orientation(wordOrientation), content(wordContent) {
-    if (content.empty()) {
-        content = DEFAULT_WORD;
+    : wordStart({x, y}) {
+    if (wordContent.empty()) {
+        wordContent = DEFAULT_WORD;
+    }
+    layout = wordContent.size() << 1 | wordOrientation;
+    char *dest = inlineLetters;
+    if (!is_inline()) {
+        outOfLine.resource = std::pmr::get_default_resource();
+        outOfLine.letters = static_cast<char *>(
+            outOfLine.resource->allocate(wordContent.size(), 1));
+        dest = outOfLine.letters;
     }
-    std::transform(content.begin(), content.end(), content.begin(), ::toupper);
+    std::copy(wordContent.begin(), wordContent.end(), dest);
+    upper_case(dest, dest + wordContent.size());
 }
 
-Word::Word(const Word &word)
-    : wordStart(word.wordStart), orientation(word.orientation),
-      content(word.content) {}
+Word::Word(pos_t start, orientation_t wordOrientation,
+           std::string_view wordLetters)
+    : wordStart(start), layout(wordLetters.size() << 1 | wordOrientation) {
+    char *dest = inlineLetters;
+    if (!is_inline()) {
+        outOfLine.resource = std::pmr::get_default_resource();
+        outOfLine.letters = static_cast<char *>(
+            outOfLine.resource->allocate(wordLetters.size(), 1));
+        dest = outOfLine.letters;
+    }
+    std::copy(wordLetters.begin(), wordLetters.end(), dest);
+}
 
-Word::Word(Word &&word)
-    : wordStart(std::move(word.wordStart)),
-      orientation(std::move(word.orientation)),
-      content(std::move(word.content)) {}
+Word::Word(const Word &word) : wordStart(word.wordStart), layout(0) {
+    assign(word, std::pmr::get_default_resource());
+}
+
+Word::Word(const Word &word, const allocator_type &alloc)
+    : wordStart(word.wordStart), layout(0) {
+    assign(word, alloc.resource());
+}
+
+Word::Word(Word &&word) noexcept : wordStart(word.wordStart) { take(word); }
+
+Word::~Word() { release(); }
 
 Word &Word::operator=(const Word &word) {
-    wordStart = word.wordStart;
-    orientation = word.orientation;
-    content = word.content;
+    if (this != &word) {
+        std::pmr::memory_resource *resource =
+            is_inline() ? std::pmr::get_default_resource() : outOfLine.resource;
+        release();
+        wordStart = word.wordStart;
+        assign(word, resource);
+    }
     return *this;
 }
 
-Word &Word::operator=(Word &&word) {
-    wordStart = std::move(word.wordStart);
-    orientation = std::move(word.orientation);
-    content = std::move(word.content);
+Word &Word::operator=(Word &&word) noexcept {
+    if (this != &word) {
+        release();
+        wordStart = word.wordStart;
+        take(word);
+    }
     return *this;
 }
 
-pos_t Word::get_end_position() const {
-    return pos_of_letter(content.size() - 1);
+// Copies the orientation and letters of word into this released word.
+void Word::assign(const Word &word, std::pmr::memory_resource *resource) {
+    layout = word.layout;
+    if (is_inline()) {
+        std::copy_n(word.inlineLetters, length(), inlineLetters);
+    } else {
+        outOfLine.resource = resource;
+        outOfLine.letters =
+            static_cast<char *>(resource->allocate(word.length(), 1));
+        std::copy_n(word.outOfLine.letters, word.length(), outOfLine.letters);
+    }
+}
+
+// Moves the orientation and letters of word into this released word, and
+// leaves word with no letters.
+void Word::take(Word &word) noexcept {
+    layout = word.layout;
+    if (is_inline())
+        std::copy_n(word.inlineLetters, length(), inlineLetters);
+    else
+        outOfLine = word.outOfLine;
+    word.layout &= 1;
+}
+
+void Word::release() {
+    if (!is_inline())
+        outOfLine.resource->deallocate(outOfLine.letters, length(), 1);
+    layout &= 1;
 }
 
 char Word::at(size_t pos) const {
-    if (pos >= content.size())
+    if (pos >= length())
         return DEFAULT_CHAR;
-    return content[pos];
+    return letters()[pos];
 }
 
 std::weak_ordering Word::operator<=>(const Word &word) const {
     if (wordStart.first == word.wordStart.first) {
         if (wordStart.second == word.wordStart.second) {
-            if (orientation == word.orientation) {
+            if (get_orientation() == word.get_orientation()) {
                 return std::weak_ordering::equivalent;
-            } else if (orientation == H) {
+            } else if (get_orientation() == H) {
                 return std::weak_ordering::less;
             } else {
                 return std::weak_ordering::greater;
@@ -86,293 +269,1153 @@ bool Word::operator==(const Word &word) const {
 
 bool Word::operator!=(const Word &word) const { return !(*this == word); }
 
-RectArea Word::rect_area() const {
-    return RectArea(get_start_position(), get_end_position());
-}
-
 std::optional<char> Word::at(pos_t pos) const {
     if (wordStart <= pos && pos <= get_end_position()) {
-        if (orientation == H && pos.second == wordStart.second) {
-            return content[pos.first - wordStart.first];
-        } else if (orientation == V && pos.first == wordStart.first) {
-            return content[pos.second - wordStart.second];
+        if (get_orientation() == H && pos.second == wordStart.second) {
+            return letters()[pos.first - wordStart.first];
+        } else if (get_orientation() == V && pos.first == wordStart.first) {
+            return letters()[pos.second - wordStart.second];
         }
     }
 
     return {};
 }
 
-pos_t Word::pos_of_letter(size_t offset) const {
-    // offset - the position of the letter in the word
-    if (orientation == H) {
-        return {wordStart.first + offset, wordStart.second};
-    } else {
-        return {wordStart.first, wordStart.second + offset};
+// Helper structures implementation:
+
+// WordArena implementation:
+
+WordArena::WordArena() : memory(store_upstream()), blocks(), count(0) {}
+
+WordArena::handle_t WordArena::store(const Word &w) {
+    reserve(count + 1);
+    handle_t handle = count++;
+    // Words are never destroyed one by one: the letters of a stored word come
+    // from the same monotonic resource, so releasing it frees everything.
+    new (&(*this)[handle]) Word(w, Word::allocator_type(&memory));
+    return handle;
+}
+
+void WordArena::reserve(size_t words) {
+    while (blocks.size() * BLOCK_WORDS < words) {
+        void *block = memory.allocate(BLOCK_WORDS * sizeof(Word), alignof(Word));
+        blocks.push_back(static_cast<Word *>(block));
     }
 }
 
-// RectArea implementation:
+CellIndex::CellIndex(std::pmr::memory_resource *resource) : tiles(resource) {}
 
-bool RectArea::pointInRect(pos_t point) const {
-    return point.first >= leftUpper.first && point.second >= leftUpper.second &&
-           point.first <= rightBottom.first &&
-           point.second <= rightBottom.second;
+size_t CellIndex::tile_hash::operator()(const pos_t &key) const {
+    size_t h = key.first * 0x9e3779b97f4a7c15ULL ^ key.second;
+    h ^= h >> 32;
+    h *= 0xd6e8feb86659fd93ULL;
+    return h ^ (h >> 32);
 }
 
-bool RectArea::rectInRect(RectArea rectArea) const {
-    return pointInRect(rectArea.get_left_top()) &&
-           pointInRect(rectArea.get_right_top()) &&
-           pointInRect(rectArea.get_left_bottom()) &&
-           pointInRect(rectArea.get_right_bottom());
+std::optional<char> CellIndex::at(pos_t pos) const {
+    Cursor cursor;
+    return at(pos, cursor);
 }
 
-RectArea::RectArea(pos_t left_top, pos_t right_bottom)
-    : leftUpper(left_top), rightBottom(right_bottom) {}
+const CellIndex::tile_t *CellIndex::find(pos_t pos, Cursor &cursor) const {
+    pos_t key = tile_of(pos);
+    if (cursor.key != key || (cursor.tile == nullptr && !cursor.missing)) {
+        auto it = tiles.find(key);
+        cursor.key = key;
+        cursor.missing = it == tiles.end();
+        cursor.tile =
+            cursor.missing ? nullptr : const_cast<tile_t *>(&it->second);
+    }
+    return cursor.tile;
+}
 
-RectArea::RectArea(const RectArea &rectArea)
-    : leftUpper(rectArea.leftUpper), rightBottom(rectArea.rightBottom) {}
+std::optional<char> CellIndex::at(pos_t pos, Cursor &cursor) const {
+    const tile_t *tile = find(pos, cursor);
+    if (tile == nullptr)
+        return {};
+    char letter = (*tile)[offset_in_tile(pos)];
+    if (letter == '\0')
+        return {};
+    return letter;
+}
 
-RectArea::RectArea(RectArea &&rectArea)
-    : leftUpper(std::move(rectArea.leftUpper)),
-      rightBottom(std::move(rectArea.rightBottom)) {}
+bool CellIndex::fill_line(pos_t pos, orientation_t orientation, char *out,
+                          Cursor &cursor) const {
+    const tile_t *tile = find(pos, cursor);
+    if (tile == nullptr)
+        return false;
+    if (orientation == H) {
+        const char *row = &(*tile)[offset_in_tile({0, pos.second})];
+#if defined(__SSE2__)
+        __m128i have = _mm_loadu_si128(reinterpret_cast<__m128i *>(out));
+        __m128i cells =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(row));
+        __m128i empty = _mm_cmpeq_epi8(have, _mm_setzero_si128());
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out),
+                         _mm_or_si128(have, _mm_and_si128(empty, cells)));
+#else
+        for (size_t i = 0; i < TILE_SIDE; i++)
+            out[i] = out[i] != '\0' ? out[i] : row[i];
+#endif
+        return true;
+    }
+    for (size_t i = 0; i < TILE_SIDE; i++) {
+        if (out[i] == '\0')
+            out[i] = (*tile)[offset_in_tile({pos.first, i})];
+    }
+    return true;
+}
 
-RectArea &RectArea::operator=(const RectArea &rectArea) {
-    leftUpper = rectArea.leftUpper;
-    rightBottom = rectArea.rightBottom;
-    return *this;
+void CellIndex::clear_blanks(char *line) {
+#if defined(__SSE2__)
+    __m128i cells = _mm_loadu_si128(reinterpret_cast<__m128i *>(line));
+    __m128i blank = _mm_cmpeq_epi8(cells, _mm_set1_epi8(BLANK));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(line),
+                     _mm_andnot_si128(blank, cells));
+#else
+    std::replace(line, line + TILE_SIDE, BLANK, '\0');
+#endif
 }
 
-RectArea &RectArea::operator=(RectArea &&rectArea) {
-    leftUpper = std::move(rectArea.leftUpper);
-    rightBottom = std::move(rectArea.rightBottom);
-    return *this;
+char &CellIndex::cell(pos_t pos, Cursor &cursor) {
+    pos_t key = tile_of(pos);
+    if (cursor.tile == nullptr || cursor.key != key) {
+        auto [it, created] = tiles.try_emplace(key);
+        if (created)
+            it->second.fill('\0');
+        cursor.key = key;
+        cursor.tile = &it->second;
+        cursor.missing = false;
+    }
+    return (*cursor.tile)[offset_in_tile(pos)];
 }
 
-const RectArea RectArea::operator*(const RectArea &rectArea) const {
-    return RectArea(*this) *= rectArea;
+void CellIndex::set(pos_t pos, char letter, Cursor &cursor) {
+    // '\0' and BLANK mark empty cells; any other non-letter prints and
+    // compares the same way.
+    cell(pos, cursor) =
+        letter == '\0' || letter == BLANK ? DEFAULT_CHAR : letter;
 }
 
-RectArea &RectArea::operator*=(const RectArea &rectArea) {
-    if (empty()) {
-        return *this;
+void CellIndex::blank(pos_t pos, Cursor &cursor) { cell(pos, cursor) = BLANK; }
+
+void CellIndex::erase(pos_t pos, Cursor &cursor) {
+    pos_t key = tile_of(pos);
+    if (cursor.tile == nullptr || cursor.key != key) {
+        auto it = tiles.find(key);
+        if (it == tiles.end())
+            return;
+        cursor.key = key;
+        cursor.tile = &it->second;
     }
-    if (rectArea.empty()) {
-        set_left_top({1, 1});
-        set_right_bottom({0, 0});
-        return *this;
+    (*cursor.tile)[offset_in_tile(pos)] = '\0';
+}
+
+void CellIndex::reserve(size_t count) { tiles.reserve(tiles.size() + count); }
+
+WordStore::WordStore()
+    : parent(), depth(1), base_count(0, 0), arena(),
+      h_words(arena.resource()), v_words(arena.resource()),
+      cells(arena.resource()), checked(true), single_letters(0),
+      edges{edge_count_t(arena.resource()), edge_count_t(arena.resource()),
+            edge_count_t(arena.resource()), edge_count_t(arena.resource())},
+      unstored(DEFAULT_EMPTY_RECT_AREA), erased(arena.resource()),
+      tombstones(0, 0), crossings(arena.resource()), parents(arena.resource()),
+      component_sizes(arena.resource()), crossing_count(0), components(0),
+      degree_counts(arena.resource()), splits(0) {}
+
+WordStore::WordStore(std::shared_ptr<const WordStore> parent_layer)
+    : parent(std::move(parent_layer)), depth(parent->depth + 1),
+      base_count(parent->base_count.first + parent->h_words.size(),
+                 parent->base_count.second + parent->v_words.size()),
+      arena(), h_words(arena.resource()), v_words(arena.resource()),
+      cells(arena.resource()), checked(parent->checked),
+      single_letters(parent->single_letters),
+      edges{edge_count_t(arena.resource()), edge_count_t(arena.resource()),
+            edge_count_t(arena.resource()), edge_count_t(arena.resource())},
+      unstored(DEFAULT_EMPTY_RECT_AREA), erased(arena.resource()),
+      tombstones(parent->tombstones), crossings(arena.resource()),
+      parents(arena.resource()), component_sizes(arena.resource()),
+      crossing_count(parent->crossing_count), components(parent->components),
+      degree_counts(parent->degree_counts, arena.resource()), splits(0) {}
+
+void WordStore::reserve(size_t words) {
+    arena.reserve(arena.size() + words);
+    // Most words fit in one or two tiles.
+    cells.reserve(words);
+}
+
+const Word *WordStore::find(pos_t start, orientation_t orientation) const {
+    auto found = [start](auto &word_set) -> const Word * {
+        auto it = word_set.find(start);
+        return it == word_set.end() ? nullptr : *it;
+    };
+    return orientation == H ? found(h_words) : found(v_words);
+}
+
+const Word *WordStore::lookup(pos_t start, orientation_t orientation) const {
+    for (const WordStore *layer = this; layer != nullptr;
+         layer = layer->parent.get()) {
+        const Word *w = layer->find(start, orientation);
+        if (w != nullptr && !hides(w))
+            return w;
     }
+    return nullptr;
+}
 
-    if (rectInRect(rectArea)) {
-        set_left_top(rectArea.get_left_top());
-        set_right_bottom(rectArea.get_right_bottom());
-    } else if (rectArea.rectInRect(*this)) {
-        set_left_top(get_left_top());
-        set_right_bottom(get_right_bottom());
+bool WordStore::is_erased(const Word *w) const {
+    for (const WordStore *layer = this; layer != nullptr;
+         layer = layer->parent.get()) {
+        if (!layer->erased.empty() && layer->erased.contains(w))
+            return true;
     }
-    // rectArea on right-bottom:
-    else if (pointInRect(rectArea.get_left_top())) {
-        set_left_top(rectArea.get_left_top());
-        set_right_bottom(get_right_bottom());
+    return false;
+}
+
+size_t WordStore::degree(const Word *w) const {
+    size_t count = 0;
+    if (tombstones != dim_t(0, 0)) {
+        for_each_crossing(w, [&count](const Crossing &) { count++; });
+        return count;
     }
-    // rectArea on left-bottom:
-    else if (pointInRect(rectArea.get_right_top())) {
-        set_right_top(rectArea.get_right_top());
-        set_left_bottom(get_left_bottom());
+    for (const WordStore *layer = this; layer != nullptr;
+         layer = layer->parent.get()) {
+        auto it = layer->crossings.find(w);
+        if (it != layer->crossings.end())
+            count += it->second.size();
     }
-    // rectArea on left-top:
-    else if (pointInRect(rectArea.get_right_bottom())) {
-        set_left_top(get_left_top());
-        set_right_bottom(rectArea.get_right_bottom());
+    return count;
+}
+
+const Word *WordStore::root(const Word *w) const {
+    for (const WordStore *layer = this; layer != nullptr;) {
+        auto it = layer->parents.find(w);
+        if (it == layer->parents.end()) {
+            layer = layer->parent.get();
+        } else if (it->second == w) {
+            return w;
+        } else {
+            w = it->second;
+            layer = this;
+        }
     }
-    // rectArea on right-top:
-    else if (pointInRect(rectArea.get_left_bottom())) {
-        set_right_top(get_right_top());
-        set_left_bottom(rectArea.get_left_bottom());
-    } else {
-        set_left_top({1, 1});
-        set_right_bottom({0, 0});
+    return w;
+}
+
+size_t WordStore::component_size(const Word *root) const {
+    for (const WordStore *layer = this; layer != nullptr;
+         layer = layer->parent.get()) {
+        auto it = layer->component_sizes.find(root);
+        if (it != layer->component_sizes.end())
+            return it->second;
     }
+    return 1;
+}
 
-    return *this;
+void WordStore::count_degree(size_t from, size_t to) {
+    if (from > 0)
+        degree_counts[from - 1]--;
+    if (to > degree_counts.size())
+        degree_counts.resize(to);
+    if (to > 0)
+        degree_counts[to - 1]++;
 }
 
-dim_t RectArea::size() const {
-    if (empty())
-        return {0, 0};
+const Word *WordStore::cross(const Word *a, const Word *b, pos_t cell) {
+    size_t a_degree = degree(a), b_degree = degree(b);
+    crossings[a].push_back({b, cell});
+    crossings[b].push_back({a, cell});
+    count_degree(a_degree, a_degree + 1);
+    count_degree(b_degree, b_degree + 1);
+    crossing_count++;
+
+    const Word *a_root = root(a), *b_root = root(b);
+    if (a_root == b_root)
+        return nullptr;
+    size_t a_size = component_size(a_root), b_size = component_size(b_root);
+    if (a_size < b_size)
+        std::swap(a_root, b_root);
+    parents[b_root] = a_root;
+    component_sizes[a_root] = a_size + b_size;
+    components--;
+    return b_root;
+}
 
-    size_t width = get_right_top().first - get_left_top().first + 1;
-    size_t height = get_left_bottom().second - get_left_top().second + 1;
-    return {width, height};
+void WordStore::unjoin(const Word *root) {
+    const Word *joined = parents.at(root);
+    component_sizes.at(joined) -= component_size(root);
+    parents[root] = root;
+    components++;
 }
 
-void RectArea::embrace(pos_t point) {
-    if (pointInRect(point))
+// Crossings recorded in parent layers stay there, and are left out once w
+// is erased.
+void WordStore::uncross(const Word *w, bool split) {
+    std::vector<Crossing> crossed;
+    for_each_crossing(w,
+                      [&crossed](const Crossing &c) { crossed.push_back(c); });
+    crossings.erase(w);
+    count_degree(crossed.size(), 0);
+    crossing_count -= crossed.size();
+    for (const Crossing &crossing : crossed) {
+        size_t before = degree(crossing.word);
+        auto back = crossings.find(crossing.word);
+        if (back != crossings.end()) {
+            auto it = std::find_if(back->second.begin(), back->second.end(),
+                                   [w](auto &c) { return c.word == w; });
+            if (it != back->second.end())
+                back->second.erase(it);
+        }
+        count_degree(before, before - 1);
+    }
+    parents.erase(w);
+    component_sizes.erase(w);
+    components--;
+    if (!split)
         return;
 
-    if (empty()) {
-        leftUpper = point;
-        rightBottom = point;
-        return;
+    // Each part of the rest of the component, reached from a word w
+    // crossed, gets that word for its root.
+    std::unordered_set<const Word *> seen;
+    std::vector<const Word *> pending;
+    for (const Crossing &crossing : crossed) {
+        const Word *part = crossing.word;
+        if (!seen.insert(part).second)
+            continue;
+        size_t size = 0;
+        pending.push_back(part);
+        while (!pending.empty()) {
+            const Word *next = pending.back();
+            pending.pop_back();
+            parents[next] = part;
+            size++;
+            for_each_crossing(next, [&](const Crossing &c) {
+                if (c.word != w && seen.insert(c.word).second)
+                    pending.push_back(c.word);
+            });
+        }
+        component_sizes[part] = size;
+        components++;
     }
+    splits++;
+}
 
-    if (point.first < leftUpper.first) {
-        leftUpper.first = point.first;
-    } else if (point.first > rightBottom.first) {
-        rightBottom.first = point.first;
+// Visits the words in the order they were inserted: layer by layer, from
+// the bottom one. Words added by f itself and erased ones are not visited.
+template <typename F> void WordStore::for_each_word(F &&f) const {
+    bool buried = tombstones != dim_t(0, 0);
+    std::array<const WordStore *, WordStore::MAX_DEPTH> layers;
+    std::array<size_t, WordStore::MAX_DEPTH> sizes;
+    size_t depth = 0;
+    for (const WordStore *layer = this; layer != nullptr;
+         layer = layer->parent.get(), depth++) {
+        layers[depth] = layer;
+        sizes[depth] = layer->arena.size();
     }
-
-    if (point.second < leftUpper.second) {
-        leftUpper.second = point.second;
-    } else if (point.second > rightBottom.second) {
-        rightBottom.second = point.second;
+    while (depth-- > 0) {
+        const WordStore *layer = layers[depth];
+        for (size_t i = 0; i < sizes[depth]; i++) {
+            const Word &w = layer->arena[i];
+            if (buried ? !is_erased(&w)
+                       : layer->erased.empty() || !layer->erased.contains(&w))
+                f(w);
+        }
     }
 }
 
-// Helper structures implementation:
+// Crossword implementation:
+
+#ifdef CROSSWORDS_STATS
+Crossword::StatsScope::StatsScope(const Crossword &crossword, counter_t time)
+    : crossword(crossword), time(time),
+      start(std::chrono::steady_clock::now()), bytes(store_bytes) {}
 
-bool vertical_cmp::operator()(Word *w1, Word *w2) const {
-    return w1->get_start_position() < w2->get_start_position();
+Crossword::StatsScope::~StatsScope() {
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    crossword.count(time, elapsed.count());
+    crossword.count(BYTES_ALLOCATED, store_bytes - bytes);
 }
+#endif
 
-bool horizontal_cmp::operator()(Word *w1, Word *w2) const {
-    pos_t p1 = w1->get_start_position();
-    pos_t p2 = w2->get_start_position();
-    std::swap(p1.first, p1.second);
-    std::swap(p2.first, p2.second);
-    return p1 < p2;
+CrosswordStats Crossword::stats() const {
+    CrosswordStats stats;
+#ifdef CROSSWORDS_STATS
+    auto get = [this](counter_t counter) {
+        return counters[counter].load(std::memory_order_relaxed);
+    };
+    stats.letter_lookups = get(LETTER_LOOKUPS);
+    stats.word_lookups = get(WORD_LOOKUPS);
+    stats.collision_checks = get(COLLISION_CHECKS);
+    stats.collisions = get(COLLISIONS);
+    stats.words_inserted = get(WORDS_INSERTED);
+    stats.words_rejected = get(WORDS_REJECTED);
+    stats.bytes_allocated = get(BYTES_ALLOCATED);
+    stats.insert_time = std::chrono::nanoseconds(get(INSERT_TIME));
+    stats.merge_time = std::chrono::nanoseconds(get(MERGE_TIME));
+    stats.render_time = std::chrono::nanoseconds(get(RENDER_TIME));
+#endif
+    return stats;
 }
 
-// Crossword implementation:
+void Crossword::reset_stats() {
+#ifdef CROSSWORDS_STATS
+    for (std::atomic<uint64_t> &counter : counters)
+        counter.store(0, std::memory_order_relaxed);
+#endif
+}
 
 Crossword::Crossword(Word const &first, std::initializer_list<Word> other)
-    : h_words(), v_words(), words(), area(DEFAULT_EMPTY_RECT_AREA) {
+    : store(std::make_shared<WordStore>()), area(DEFAULT_EMPTY_RECT_AREA) {
     insert_word(first, false);
-    std::for_each(other.begin(), other.end(),
-                  [this](Word const &w) { this->insert_word(w); });
+    insert_words(other);
 }
 
+Crossword::Crossword()
+    : store(std::make_shared<WordStore>()), area(DEFAULT_EMPTY_RECT_AREA) {}
+
 Crossword::Crossword(const Crossword &other)
-    : h_words(), v_words(), words(), area(other.area) {
-    for (Word *w : other.words) {
-        insert_word(*w, false);
-    }
+    : store(other.store), area(other.area),
+      render_cache_limit(other.render_cache_limit) {}
+
+Crossword::Crossword(Crossword &&other) noexcept
+    : store(std::exchange(other.store, empty_store())),
+      area(std::exchange(other.area, DEFAULT_EMPTY_RECT_AREA)),
+      journal(std::exchange(other.journal, {})),
+      journal_cells(std::exchange(other.journal_cells, {})),
+      journal_roots(std::exchange(other.journal_roots, {})),
+      checkpoints(std::exchange(other.checkpoints, {})),
+      erasures(other.erasures),
+      render_cache_limit(other.render_cache_limit) {}
+
+void Crossword::make_writable() {
+    if (store.use_count() == 1)
+        return;
+    if (store.use_count() == 0)
+        store = std::make_shared<WordStore>();
+    else if (store->depth < WordStore::MAX_DEPTH)
+        store = std::make_shared<WordStore>(std::move(store));
+    else
+        compact();
 }
 
-Crossword::Crossword(Crossword &&other)
-    : h_words(std::move(other.h_words)), v_words(std::move(other.v_words)),
-      words(std::move(other.words)), area(std::move(other.area)) {}
-
-Crossword::~Crossword() { delete_words(); }
+// The top layers are merged down to the first one holding more than twice
+// as many words as those above it, so that a word is merged again only
+// once the layers above have grown to its own. Only if there is no such
+// layer is the whole stack flattened, once the words added since the bottom
+// layer was made are a third of all.
+void Crossword::compact() {
+    std::shared_ptr<const WordStore> top = store;
+    std::shared_ptr<const WordStore> base = store;
+    size_t merged = 0, layers = 0;
+    do {
+        merged += base->arena.size();
+        layers++;
+        base = base->parent;
+    } while (base != nullptr &&
+             (layers < 2 || base->arena.size() <= 2 * merged));
+    if (base == nullptr) {
+        flatten();
+        return;
+    }
 
-bool Crossword::does_collide(const Word &w) const {
-    for (size_t i = 0; i < w.length(); i++) {
-        pos_t pos = w.pos_of_letter(i);
-        std::optional<char> letter = letter_at(pos);
+    // As with flatten, the words stay the same.
+    std::vector<Checkpoint> open = std::exchange(checkpoints, {});
+    RenderCache rendered = std::exchange(render_cache, {});
+    RectArea kept = area;
+    size_t erased = erasures;
+    store = std::make_shared<WordStore>(base);
+    store->reserve(merged);
+
+    std::vector<const WordStore *> above;
+    for (const WordStore *layer = top.get(); layer != base.get();
+         layer = layer->parent.get())
+        above.push_back(layer);
+    // Words of the layers below erased in the merged ones are erased again,
+    // then the words left in the merged ones are stored in their order.
+    for (const WordStore *layer : above) {
+        for (const Word *w : layer->erased) {
+            pos_t start = w->get_start_position();
+            if (base->lookup(start, w->get_orientation()) == w)
+                erase_word(start, w->get_orientation());
+        }
+    }
+    InsertCursor cursor;
+    for (auto layer = above.rbegin(); layer != above.rend(); ++layer) {
+        for (size_t i = 0; i < (*layer)->arena.size(); i++) {
+            const Word &w = (*layer)->arena[i];
+            if (!top->is_erased(&w))
+                insert_word(w, false, cursor);
+        }
+        if (!(*layer)->unstored.empty()) {
+            store->unstored.embrace((*layer)->unstored.get_left_top());
+            store->unstored.embrace((*layer)->unstored.get_right_bottom());
+        }
+    }
+    store->checked = top->checked;
+    checkpoints = std::move(open);
+    render_cache = std::move(rendered);
+    area = kept;
+    erasures = erased;
+}
 
-        if (letter.has_value() &&
-            !Word::are_letters_the_same(*letter, w.at(i))) {
-            return true;
-        } else if (!letter.has_value()) {
-            if (w.get_orientation() == H && pos.second > 0) {
-                pos.second--;
-                if (letter_at(pos).has_value())
-                    return true;
-                pos.second++;
-            } else if (w.get_orientation() == V && pos.first > 0) {
-                pos.first--;
-                if (letter_at(pos).has_value())
-                    return true;
-                pos.first++;
-            }
+void Crossword::flatten() {
+    // Moving words to the new layer is not a change to record, nor does it
+    // change the rendering.
+    std::vector<Checkpoint> open = std::exchange(checkpoints, {});
+    RenderCache rendered = std::exchange(render_cache, {});
+    std::shared_ptr<const WordStore> layers = std::move(store);
+    store = std::make_shared<WordStore>();
+    store->reserve(layers->base_count.first + layers->base_count.second +
+                   layers->arena.size());
+    store->checked = layers->checked;
+
+    InsertCursor cursor;
+    layers->for_each_word(
+        [this, &cursor](const Word &w) { insert_word(w, false, cursor); });
+    for (const WordStore *layer = layers.get(); layer != nullptr;
+         layer = layer->parent.get()) {
+        if (!layer->unstored.empty()) {
+            store->unstored.embrace(layer->unstored.get_left_top());
+            store->unstored.embrace(layer->unstored.get_right_bottom());
+        }
+    }
+    checkpoints = std::move(open);
+    render_cache = std::move(rendered);
+}
 
-            if (w.get_orientation() == H && pos.second < MAX_COORDINATE) {
-                pos.second++;
-                if (letter_at(pos).has_value())
-                    return true;
-            } else if (w.get_orientation() == V && pos.first < MAX_COORDINATE) {
-                pos.first++;
-                if (letter_at(pos).has_value())
-                    return true;
+// Once words of parent layers are erased, the first and last words of a
+// layer may be erased ones, and an edge it counts may be counted off by the
+// layers above it.
+void Crossword::update_area() {
+    area = DEFAULT_EMPTY_RECT_AREA;
+    const bool buried = store->tombstones != dim_t(0, 0);
+    auto live = [this, buried](auto it, auto end) {
+        while (buried && it != end && store->is_erased(*it))
+            ++it;
+        return it;
+    };
+    auto counted = [this](WordStore::edge_t edge, cord_t at) {
+        ptrdiff_t count = 0;
+        for (const WordStore *layer = store.get(); layer != nullptr;
+             layer = layer->parent.get()) {
+            auto it = layer->edges[edge].find(at);
+            if (it != layer->edges[edge].end())
+                count += it->second;
+        }
+        return count > 0;
+    };
+    // The outermost edge of one kind counted by the layers, the lowest or
+    // the highest.
+    auto outermost = [&](WordStore::edge_t edge, bool highest) {
+        std::optional<cord_t> found;
+        auto scan = [&](auto it, auto end) {
+            for (; it != end; ++it) {
+                if (it->second <= 0 || (buried && !counted(edge, it->first)))
+                    continue;
+                if (!found.has_value() ||
+                    (highest ? it->first > *found : it->first < *found))
+                    found = it->first;
+                return;
             }
+        };
+        for (const WordStore *layer = store.get(); layer != nullptr;
+             layer = layer->parent.get()) {
+            const auto &counts = layer->edges[edge];
+            if (highest)
+                scan(counts.rbegin(), counts.rend());
+            else
+                scan(counts.begin(), counts.end());
+        }
+        return found;
+    };
+    // The lines of words of one orientation span, between the first and the
+    // last of them, and their edges along the lines.
+    auto embrace_words = [&](auto word_set_of, WordStore::edge_t before,
+                             WordStore::edge_t after, bool horizontal) {
+        auto line_of = [horizontal](const Word *w) {
+            pos_t start = w->get_start_position();
+            return horizontal ? start.second : start.first;
+        };
+        std::optional<cord_t> first, last;
+        for (const WordStore *layer = store.get(); layer != nullptr;
+             layer = layer->parent.get()) {
+            const auto &words = word_set_of(*layer);
+            auto it = live(words.begin(), words.end());
+            if (it == words.end())
+                continue;
+            cord_t first_line = line_of(*it);
+            cord_t last_line = line_of(*live(words.rbegin(), words.rend()));
+            first = std::min(first.value_or(first_line), first_line);
+            last = std::max(last.value_or(last_line), last_line);
+        }
+        if (!first.has_value())
+            return;
+        cord_t low = *outermost(before, false);
+        cord_t high = *outermost(after, true);
+        area.embrace(horizontal ? pos_t(low, *first) : pos_t(*first, low));
+        area.embrace(horizontal ? pos_t(high, *last) : pos_t(*last, high));
+    };
+    embrace_words(
+        [](const WordStore &layer) -> auto & { return layer.h_words; },
+        WordStore::LEFT, WordStore::RIGHT, true);
+    embrace_words(
+        [](const WordStore &layer) -> auto & { return layer.v_words; },
+        WordStore::TOP, WordStore::BOTTOM, false);
+    for (const WordStore *layer = store.get(); layer != nullptr;
+         layer = layer->parent.get()) {
+        if (!layer->unstored.empty()) {
+            area.embrace(layer->unstored.get_left_top());
+            area.embrace(layer->unstored.get_right_bottom());
         }
     }
+}
+
+std::optional<char> Crossword::letter_at(pos_t pos,
+                                         LayerCursors &cursors) const {
+    CROSSWORDS_STAT(count(LETTER_LOOKUPS));
+    size_t i = 0;
+    for (const WordStore *layer = store.get(); layer != nullptr;
+         layer = layer->parent.get(), i++) {
+        std::optional<char> letter = layer->cells.at(pos, cursors[i]);
+        if (letter.has_value())
+            return letter != CellIndex::BLANK ? letter : std::nullopt;
+    }
+    return {};
+}
+
+std::string Crossword::pattern_at(pos_t start, orientation_t orientation,
+                                  size_t length) const {
+    std::string pattern(length, DEFAULT_CHAR);
+    LayerCursors cursors = {};
+    for (size_t i = 0; i < length; i++) {
+        pos_t pos = orientation == H ? pos_t(start.first + i, start.second)
+                                     : pos_t(start.first, start.second + i);
+        if (std::optional<char> letter = letter_at(pos, cursors))
+            pattern[i] = *letter;
+    }
+    return pattern;
+}
+
+std::vector<Crossword::Crossing> Crossword::crossings_of(const Word *w) const {
+    std::vector<Crossing> found;
+    found.reserve(degree(w));
+    for_each_crossing(w, [&found](const Crossing &c) { found.push_back(c); });
+    return found;
+}
+
+size_t Crossword::degree(const Word *w) const { return store->degree(w); }
+
+std::vector<size_t> Crossword::degree_counts() const {
+    const auto &counts = store->degree_counts;
+    size_t degrees = counts.size();
+    while (degrees > 0 && counts[degrees - 1] == 0)
+        degrees--;
+    std::vector<size_t> result(degrees + 1);
+    result[0] = word_count().first + word_count().second;
+    for (size_t d = 1; d <= degrees; d++) {
+        result[d] = counts[d - 1];
+        result[0] -= counts[d - 1];
+    }
+    return result;
+}
+
+size_t Crossword::component_size(const Word *w) const {
+    return store->component_size(store->root(w));
+}
+
+bool Crossword::connected(const Word *a, const Word *b) const {
+    return store->root(a) == store->root(b);
+}
+
+bool Crossword::does_collide(const Word &w, LayerCursors &cursors) const {
+    bool collides = has_collision(w, cursors);
+    CROSSWORDS_STAT(count(COLLISION_CHECKS));
+    CROSSWORDS_STAT(count(COLLISIONS, collides));
+    return collides;
+}
+
+bool Crossword::has_collision(const Word &w, LayerCursors &cursors) const {
+    auto letter = [this, &cursors](pos_t pos) {
+        return letter_at(pos, cursors);
+    };
+    if (w.length() >= LINE_CHECK_LENGTH)
+        return lines_collide(w, cursors) || ends_collide(w, letter) ||
+               overlaps_parallel(w);
+    return collides_with_letters(w, letter) || overlaps_parallel(w);
+}
 
+// The rules of collides_with_letters for the letters of w, applied to runs
+// of w within a tile at once: the cells of the line under a run and of the
+// lines on either side are gathered from every layer, then compared whole.
+bool Crossword::lines_collide(const Word &w, LayerCursors &cursors) const {
+    constexpr size_t SIDE = CellIndex::TILE_SIDE;
+    orientation_t orientation = w.get_orientation();
+    bool horizontal = orientation == H;
     pos_t start = w.get_start_position();
-    if (w.get_orientation() == H && start.first > 0) {
-        start.first--;
-        if (letter_at(start).has_value())
-            return true;
-    } else if (w.get_orientation() == V && start.second > 0) {
-        start.second--;
-        if (letter_at(start).has_value())
+    cord_t first = horizontal ? start.first : start.second;
+    cord_t across = horizontal ? start.second : start.first;
+    alignas(16) char letters[SIDE];
+    alignas(16) char lines[3][SIDE];
+
+    for (size_t i = 0; i < w.length();) {
+        size_t lane = (first + i) & (SIDE - 1);
+        size_t run = std::min(SIDE - lane, w.length() - i);
+        std::fill(letters, letters + SIDE, '\0');
+        std::copy_n(w.letters() + i, run, letters + lane);
+        for (size_t side = 0; side < 3; side++) {
+            std::fill(lines[side], lines[side] + SIDE, '\0');
+            if ((side == 0 && across == 0) ||
+                (side == 2 && across == MAX_COORDINATE))
+                continue;
+            cord_t line = across + side - 1;
+            pos_t pos = horizontal ? pos_t(first + i, line)
+                                   : pos_t(line, first + i);
+            size_t depth = 0;
+            for (const WordStore *layer = store.get(); layer != nullptr;
+                 layer = layer->parent.get(), depth++) {
+                CROSSWORDS_STAT(count(LETTER_LOOKUPS));
+                layer->cells.fill_line(pos, orientation, lines[side],
+                                       cursors[depth]);
+            }
+            if (store->parent != nullptr)
+                CellIndex::clear_blanks(lines[side]);
+        }
+        if (lanes_collide(letters, lines[1], lines[0], lines[2],
+                          ((uint32_t(1) << run) - 1) << lane))
             return true;
+        i += run;
     }
+    return false;
+}
 
+// Whether w runs over a stored word of the same orientation. Letters of the
+// two may agree, but that does not make it a crossing. A stored word with
+// the same start and length is the same word and does not count.
+bool Crossword::overlaps_parallel(const Word &w) const {
     pos_t end = w.get_end_position();
-    if (w.get_orientation() == H && end.first < MAX_COORDINATE) {
-        end.first++;
-        if (letter_at(end).has_value())
-            return true;
-    } else if (w.get_orientation() == V && end.second < MAX_COORDINATE) {
-        end.second++;
-        if (letter_at(end).has_value())
+    auto overlaps = [this, &w, &end](auto &word_set) {
+        auto it = word_set.upper_bound(end);
+        do {
+            if (it == word_set.begin())
+                return false;
+        } while (store->hides(*--it));
+        const Word *p = *it;
+        pos_t start = w.get_start_position();
+        pos_t p_end = p->get_end_position();
+        if (p->get_start_position() == start && p->length() == w.length())
+            return false;
+        return w.get_orientation() == H
+                   ? p_end.second == start.second && p_end.first >= start.first
+                   : p_end.first == start.first && p_end.second >= start.second;
+    };
+    for (const WordStore *layer = store.get(); layer != nullptr;
+         layer = layer->parent.get()) {
+        CROSSWORDS_STAT(count(WORD_LOOKUPS));
+        if (w.get_orientation() == H ? overlaps(layer->h_words)
+                                     : overlaps(layer->v_words))
             return true;
     }
-
     return false;
 }
 
-std::optional<char> Crossword::letter_at(pos_t pos) const {
-    auto extract_letter = [](pos_t pos, std::optional<const Word *> &&w) {
-        if (w.has_value()) {
-            std::optional<char> let = w.value()->at(pos);
-            if (let.has_value())
-                return let;
+// Whether none of the stored words has a letter in the cells read by
+// a collision check of w, other than a word identical to w. A word crossing
+// w is spotted by its letters next to w, unless it has just one letter.
+bool Crossword::is_isolated(const Word &w, LayerCursors &cursors) const {
+    bool horizontal = w.get_orientation() == H;
+    for (size_t i = 0; i < w.length(); i++) {
+        pos_t pos = w.pos_of_letter(i);
+        cord_t &across = horizontal ? pos.second : pos.first;
+        if (across > 0) {
+            across--;
+            if (letter_at(pos, cursors).has_value())
+                return false;
+            across++;
         }
-        return std::optional<char>();
-    };
+        if (across < MAX_COORDINATE) {
+            across++;
+            if (letter_at(pos, cursors).has_value())
+                return false;
+            across--;
+        }
+        if (store->single_letters > 0) {
+            CROSSWORDS_STAT(count(WORD_LOOKUPS, store->depth));
+            if (store->lookup(pos, horizontal ? V : H) != nullptr)
+                return false;
+        }
+    }
+
+    pos_t start = w.get_start_position();
+    cord_t &before = horizontal ? start.first : start.second;
+    if (before > 0 && (before--, letter_at(start, cursors).has_value()))
+        return false;
+    pos_t end = w.get_end_position();
+    cord_t &after = horizontal ? end.first : end.second;
+    return !(after < MAX_COORDINATE &&
+             (after++, letter_at(end, cursors).has_value()));
+}
 
-    std::optional<char> l = extract_letter(pos, closest_word(pos, H));
-    if (l.has_value())
-        return l;
-    return extract_letter(pos, closest_word(pos, V));
+bool Crossword::insert_word(const Word &w, bool check_collisions) {
+    CROSSWORDS_STAT(StatsScope scope(*this, INSERT_TIME));
+    make_writable();
+    if (!check_collisions && word_count() != dim_t(0, 0))
+        store->checked = false;
+    InsertCursor cursor;
+    bool inserted = insert_word(w, check_collisions, cursor);
+    CROSSWORDS_STAT(count(inserted ? WORDS_INSERTED : WORDS_REJECTED));
+    return inserted;
 }
 
-std::optional<const Word *> Crossword::closest_word(const pos_t &pos,
-                                                    orientation_t ori) const {
-    if ((ori == H && h_words.empty()) || (ori == V && v_words.empty()))
-        return {};
+bool Crossword::insert_word(const Word &w, bool check_collisions,
+                           InsertCursor &cursor) {
+    if (check_collisions && does_collide(w, cursor.cells))
+        return false;
 
-    Word tmp(pos.first, pos.second, ori, "");
-    if (ori == H) {
-        FIND_CLOSEST_WORD_AND_RETURN(&h_words, tmp);
-    } else {
-        FIND_CLOSEST_WORD_AND_RETURN(&v_words, tmp);
+    // A word identical in position and orientation to a stored one adds
+    // nothing but its extent to the crossword, so it takes up no storage.
+    // One starting at the same cell, but of another length, is taken for
+    // the stored word, and only widens the crossword.
+    pos_t start = w.get_start_position();
+    pos_t end = w.get_end_position();
+    area.embrace(start);
+    area.embrace(end);
+    auto merged_into = [this, &w, &start, &end](const Word *stored) {
+        if (!checkpoints.empty())
+            journal.push_back({store.get(), false, 0, start,
+                               w.get_orientation(), store->unstored,
+                               journal_cells.size(), journal_roots.size(),
+                               store->splits});
+        if (stored->get_end_position() != end) {
+            store->unstored.embrace(start);
+            store->unstored.embrace(end);
+        }
+    };
+    for (const WordStore *layer = store->parent.get(); layer != nullptr;
+         layer = layer->parent.get()) {
+        CROSSWORDS_STAT(count(WORD_LOOKUPS));
+        const Word *stored = layer->find(start, w.get_orientation());
+        if (stored != nullptr && !store->hides(stored)) {
+            merged_into(stored);
+            return true;
+        }
     }
+    auto place = [&](auto &word_set, auto &last) {
+        Word *key = const_cast<Word *>(&w);
+        auto cmp = word_set.key_comp();
+        auto it = word_set.end();
+        if (last.has_value() && cmp(**last, key) &&
+            (std::next(*last) == word_set.end() || !cmp(*std::next(*last), key)))
+            it = std::next(*last);
+        else
+            it = word_set.lower_bound(key);
+        CROSSWORDS_STAT(count(WORD_LOOKUPS));
+
+        if (it != word_set.end() && !cmp(key, *it)) {
+            merged_into(*it);
+            last = it;
+            return;
+        }
+        WordArena::handle_t handle = store->arena.store(w);
+        Word *w_ptr = &store->arena[handle];
+        bool horizontal = w_ptr->get_orientation() == H;
+        // Only a filled cell can be crossed. The word is not indexed yet,
+        // so the words found there are the others.
+        store->components++;
+        auto cross = [this, w_ptr, horizontal](pos_t pos) {
+            for_each_word_in(RectArea(pos, pos), [&](const Word &other) {
+                if ((other.get_orientation() == H) == horizontal)
+                    return;
+                const Word *joined = store->cross(w_ptr, &other, pos);
+                if (joined != nullptr && !checkpoints.empty())
+                    journal_roots.push_back(joined);
+            });
+        };
+        // The cells under the word are gathered from every layer a run
+        // within a tile at a time, as by lines_collide.
+        constexpr size_t SIDE = CellIndex::TILE_SIDE;
+        alignas(16) char line[SIDE];
+        cord_t first = horizontal ? start.first : start.second;
+        for (size_t i = 0; i < w_ptr->length();) {
+            size_t lane = (first + i) & (SIDE - 1);
+            size_t run_end = i + std::min(SIDE - lane, w_ptr->length() - i);
+            std::fill(line, line + SIDE, '\0');
+            size_t depth = 0;
+            for (const WordStore *layer = store.get(); layer != nullptr;
+                 layer = layer->parent.get(), depth++) {
+                CROSSWORDS_STAT(count(LETTER_LOOKUPS));
+                layer->cells.fill_line(w_ptr->pos_of_letter(i),
+                                       w_ptr->get_orientation(), line,
+                                       cursor.cells[depth]);
+            }
+            if (store->parent != nullptr)
+                CellIndex::clear_blanks(line);
+            for (; i < run_end; i++, lane++) {
+                pos_t pos = w_ptr->pos_of_letter(i);
+                if (line[lane] != '\0')
+                    cross(pos);
+                if (!checkpoints.empty() && line[lane] != w_ptr->at(i))
+                    journal_cells.emplace_back(pos, line[lane]);
+                store->cells.set(pos, w_ptr->at(i), cursor.cells[0]);
+            }
+        }
+        last = word_set.emplace_hint(it, w_ptr);
+        store->single_letters += w_ptr->length() == 1;
+        count_edge(store->edges[horizontal ? WordStore::LEFT : WordStore::TOP],
+                   horizontal ? start.first : start.second, 1);
+        count_edge(
+            store->edges[horizontal ? WordStore::RIGHT : WordStore::BOTTOM],
+            horizontal ? end.first : end.second, 1);
+        mark_rows(start.second, end.second);
+        if (!checkpoints.empty())
+            journal.push_back({store.get(), true, handle, start,
+                               w.get_orientation(), store->unstored,
+                               journal_cells.size(), journal_roots.size(),
+                               store->splits});
+    };
+    if (w.get_orientation() == H)
+        place(store->h_words, cursor.last_h);
+    else
+        place(store->v_words, cursor.last_v);
+    return true;
 }
 
-bool Crossword::insert_word(const Word &w, bool check_collisions) {
-    if (check_collisions && does_collide(w))
+void Crossword::adopt_word(const Word &w, InsertCursor &cursor) {
+    make_writable();
+    insert_word(w, false, cursor);
+}
+
+void Crossword::adopt_words(const Crossword &part, const RectArea &starts,
+                            InsertCursor &cursor) {
+    make_writable();
+    part.for_each_word_in(starts, [&](const Word &w) {
+        pos_t start = w.get_start_position();
+        if (!(RectArea(start, start) * starts).empty())
+            insert_word(w, false, cursor);
+    });
+    for (const WordStore *layer = part.store.get(); layer != nullptr;
+         layer = layer->parent.get()) {
+        const RectArea &unstored = layer->unstored;
+        if (!unstored.empty()) {
+            store->unstored.embrace(unstored.get_left_top());
+            store->unstored.embrace(unstored.get_right_bottom());
+            area.embrace(unstored.get_left_top());
+            area.embrace(unstored.get_right_bottom());
+        }
+    }
+}
+
+bool Crossword::erase_word(pos_t start, orientation_t orientation) {
+    if (store->lookup(start, orientation) == nullptr)
         return false;
+    // Only the top layer, held by this crossword alone, may change. A word
+    // of a parent layer stays there, erased in the top layer.
+    make_writable();
+
+    Word *w = const_cast<Word *>(store->lookup(start, orientation));
+    store->uncross(w, true);
+    unindex(w);
+    store->erased.insert(w);
+
+    // Crossing words keep their letters.
+    bool crossed = false;
+    CellIndex::Cursor cursor;
+    for (size_t i = 0; i < w->length(); i++) {
+        pos_t cell = w->pos_of_letter(i);
+        std::optional<char> letter;
+        for_each_word_in(RectArea(cell, cell), [&letter, &cell](const Word &c) {
+            letter = c.at(cell);
+        });
+        if (letter.has_value())
+            store->cells.set(cell, *letter, cursor);
+        else
+            clear_cell(cell, cursor);
+        crossed |= letter.has_value();
+    }
+    mark_rows(w->get_start_position().second, w->get_end_position().second);
+    // The words stored after a crossed one were accepted next to its
+    // letters, and may not have been without them.
+    if (crossed)
+        store->checked = false;
+    update_area();
+    erasures++;
+    if (2 * store->erased.size() > store->arena.size() +
+                                       store->base_count.first +
+                                       store->base_count.second)
+        flatten();
+    return true;
+}
+
+bool Crossword::erase_word(const Word *w) {
+    return erase_word(w->get_start_position(), w->get_orientation());
+}
+
+void Crossword::unindex(Word *w) {
+    bool horizontal = w->get_orientation() == H;
+    size_t own = horizontal ? store->h_words.erase(w) : store->v_words.erase(w);
+    if (own == 0)
+        (horizontal ? store->tombstones.first : store->tombstones.second)++;
+    store->single_letters -= w->length() == 1;
+    pos_t start = w->get_start_position();
+    pos_t end = w->get_end_position();
+    count_edge(store->edges[horizontal ? WordStore::LEFT : WordStore::TOP],
+               horizontal ? start.first : start.second, -1);
+    count_edge(store->edges[horizontal ? WordStore::RIGHT : WordStore::BOTTOM],
+               horizontal ? end.first : end.second, -1);
+}
 
-    Word *w_ptr = new Word(w);
-    words.push_back(w_ptr);
-    if (w_ptr->get_orientation() == H)
-        h_words.insert(w_ptr);
+void Crossword::clear_cell(pos_t pos, CellIndex::Cursor &cursor) {
+    if (store->parent != nullptr)
+        store->cells.blank(pos, cursor);
     else
-        v_words.insert(w_ptr);
+        store->cells.erase(pos, cursor);
+}
 
-    area.embrace(w_ptr->get_start_position());
-    area.embrace(w_ptr->get_end_position());
-    return true;
+Crossword::checkpoint_t Crossword::checkpoint() {
+    checkpoints.push_back({journal.size(), journal_cells.size(), area,
+                           store->checked, erasures});
+    return checkpoints.size() - 1;
+}
+
+void Crossword::commit(checkpoint_t token) {
+    if (token >= checkpoints.size())
+        return;
+    checkpoints.erase(checkpoints.begin() + token, checkpoints.end());
+    if (checkpoints.empty()) {
+        journal.clear();
+        journal_cells.clear();
+        journal_roots.clear();
+    }
+}
+
+void Crossword::rollback(checkpoint_t token) {
+    if (token >= checkpoints.size())
+        return;
+    Checkpoint to = checkpoints[token];
+    checkpoints.erase(checkpoints.begin() + token, checkpoints.end());
+    // Words erased since stay erased, which neither the area nor the check
+    // saved at the checkpoint account for.
+    const bool erased = erasures != to.erasures;
+    // Undone words leave no trace, unless the layer they went to has been
+    // shared or flattened since: then they are erased as any other word.
+    std::vector<Checkpoint> open = std::exchange(checkpoints, {});
+    while (journal.size() > to.changes) {
+        const Change change = journal.back();
+        journal.pop_back();
+        undo(change, journal.empty() ? 0 : journal.back().cells_end,
+             journal.empty() ? 0 : journal.back().roots_end);
+    }
+    journal_cells.resize(to.cells);
+    journal_roots.resize(journal.empty() ? 0 : journal.back().roots_end);
+    checkpoints = std::move(open);
+    if (erased)
+        update_area();
+    else
+        area = to.area;
+    bool checked = to.checked && (!erased || store->checked);
+    if (store->checked != checked) {
+        make_writable();
+        store->checked = checked;
+    }
+}
+
+void Crossword::undo(const Change &change, size_t cells_begin,
+                     size_t roots_begin) {
+    bool top = store.get() == change.layer && store.use_count() == 1;
+    if (!change.stored) {
+        if (top)
+            store->unstored = change.unstored;
+        return;
+    }
+    Word *w = top && change.handle + 1 == store->arena.size()
+                  ? &store->arena[change.handle]
+                  : nullptr;
+    // Unions are undone in reverse, unless an erasure has taken components
+    // apart since.
+    if (w == nullptr || w->get_start_position() != change.start ||
+        w->get_orientation() != change.orientation ||
+        (!store->erased.empty() && store->erased.contains(w)) ||
+        store->splits != change.splits) {
+        erase_word(change.start, change.orientation);
+        return;
+    }
+    unindex(w);
+    for (size_t i = change.roots_end; i-- > roots_begin;)
+        store->unjoin(journal_roots[i]);
+    store->uncross(w, false);
+    store->arena.pop();
+    CellIndex::Cursor cursor;
+    for (size_t i = change.cells_end; i-- > cells_begin;) {
+        auto [pos, letter] = journal_cells[i];
+        if (letter == '\0')
+            clear_cell(pos, cursor);
+        else
+            store->cells.set(pos, letter, cursor);
+        mark_rows(pos.second, pos.second);
+    }
+}
+
+std::vector<const Word *> Crossword::words_in(const RectArea &rect) const {
+    std::vector<const Word *> found;
+    for_each_word_in(rect, [&found](const Word &w) { found.push_back(&w); });
+    return found;
 }
 
-void Crossword::delete_words() {
-    for (Word *w_ptr : words)
-        delete w_ptr;
-    words.clear();
-    v_words.clear();
-    h_words.clear();
+// Words are visited line by line - rows of horizontal words and columns of
+// vertical ones - with one search per line of rect that holds any words.
+// Parallel words never overlap in a checked crossword, so only the last word
+// starting before rect in a line can reach into it; otherwise the whole
+// line up to rect is scanned.
+void Crossword::visit_words_in(const RectArea &rect,
+                               void (*visit)(const void *context,
+                                             const Word &w),
+                               const void *context) const {
+    const RectArea query = rect * area;
+    if (query.empty())
+        return;
+
+    auto visit_lines = [&](auto &word_set, orientation_t orientation) {
+        bool horizontal = orientation == H;
+        auto line_of = [horizontal](pos_t p) {
+            return horizontal ? p.second : p.first;
+        };
+        auto along = [horizontal](pos_t p) {
+            return horizontal ? p.first : p.second;
+        };
+        auto lower_bound = [&word_set, horizontal](cord_t line, cord_t at) {
+            return word_set.lower_bound(horizontal ? pos_t(at, line)
+                                                   : pos_t(line, at));
+        };
+        pos_t lt = query.get_left_top();
+        pos_t rb = query.get_right_bottom();
+        cord_t first = along(lt), last = along(rb);
+
+        auto line_it = lower_bound(line_of(lt), 0);
+        while (line_it != word_set.end() &&
+               line_of((*line_it)->get_start_position()) <= line_of(rb)) {
+            cord_t line = line_of((*line_it)->get_start_position());
+            auto it = line_it;
+            if (store->checked) {
+                it = lower_bound(line, first);
+                if (it != line_it)
+                    --it;
+            }
+            for (; it != word_set.end() &&
+                   line_of((*it)->get_start_position()) == line &&
+                   along((*it)->get_start_position()) <= last;
+                 ++it) {
+                if (along((*it)->get_end_position()) >= first &&
+                    !store->hides(*it))
+                    visit(context, **it);
+            }
+            line_it = line < line_of(rb) ? lower_bound(line + 1, 0)
+                                         : word_set.end();
+        }
+    };
+    for (const WordStore *layer = store.get(); layer != nullptr;
+         layer = layer->parent.get()) {
+        visit_lines(layer->h_words, H);
+        visit_lines(layer->v_words, V);
+    }
 }
 
 Crossword Crossword::operator+(const Crossword &b) const {
@@ -380,63 +1423,859 @@ Crossword Crossword::operator+(const Crossword &b) const {
 }
 
 Crossword &Crossword::operator+=(const Crossword &b) {
-    for (const Word *w : b.words) {
-        insert_word(*w);
+    // Every word of b was accepted against the words of b stored before it.
+    // Merged in the same order, it can only collide with letters of this
+    // crossword or gaps left by words of b rejected during the merge - and
+    // only if those fall within its margin. All other words go in unchecked.
+    CROSSWORDS_STAT(StatsScope scope(*this, MERGE_TIME));
+    make_writable();
+    const RectArea own_area = area;
+    const std::shared_ptr<const WordStore> b_store = b.store;
+    const bool disjoint =
+        b_store->checked && !overlap(with_margin(b.area), own_area);
+    std::vector<RectArea> rejected;
+    InsertCursor cursor;
+
+    if (disjoint)
+        store->reserve(b.word_count().first + b.word_count().second);
+    b_store->for_each_word([&](const Word &w) {
+        bool check = !disjoint;
+        if (check && b_store->checked) {
+            RectArea reach = with_margin(w.rect_area());
+            check = overlap(reach, own_area) ||
+                    std::any_of(rejected.begin(), rejected.end(),
+                                [&reach](const RectArea &r) {
+                                    return overlap(reach, r);
+                                });
+        }
+        bool inserted = insert_word(w, check, cursor);
+        CROSSWORDS_STAT(count(inserted ? WORDS_INSERTED : WORDS_REJECTED));
+        if (!inserted)
+            rejected.push_back(w.rect_area());
+    });
+    return *this;
+}
+
+Crossword &Crossword::merge(const Crossword &b, size_t threads) {
+    const RectArea own_area = area;
+    const std::shared_ptr<const WordStore> b_store = b.store;
+    if (threads <= 1 || !b_store->checked ||
+        !overlap(with_margin(b.area), own_area))
+        return *this += b;
+    CROSSWORDS_STAT(StatsScope scope(*this, MERGE_TIME));
+
+    // First, each word of b that comes close to this crossword is checked
+    // against it in parallel. The verdict holds for the merge as long as no
+    // other word of b reaches into the cells read by the check, which is
+    // verified in the same pass. Words far from this crossword follow the
+    // rules of operator+=, the rest is checked again during the merge.
+    enum verdict_t : char { AWAY, ACCEPT, REJECT, RECHECK };
+    std::vector<const Word *> words;
+    words.reserve(b.word_count().first + b.word_count().second);
+    b_store->for_each_word([&words](const Word &w) { words.push_back(&w); });
+    std::vector<verdict_t> verdicts(words.size());
+
+    parallel_for(words.size(), threads, [&](size_t first, size_t last) {
+        LayerCursors own_cursors, b_cursors;
+        for (size_t i = first; i < last; i++) {
+            const Word &w = *words[i];
+            if (!overlap(with_margin(w.rect_area()), own_area))
+                verdicts[i] = AWAY;
+            else if (!b.is_isolated(w, b_cursors))
+                verdicts[i] = RECHECK;
+            else
+                verdicts[i] = does_collide(w, own_cursors) ? REJECT : ACCEPT;
+        }
+    });
+
+    make_writable();
+    std::vector<RectArea> rejected;
+    InsertCursor cursor;
+    for (size_t i = 0; i < words.size(); i++) {
+        const Word &w = *words[i];
+        bool accepted = verdicts[i] == ACCEPT;
+        if (verdicts[i] == AWAY) {
+            RectArea reach = with_margin(w.rect_area());
+            bool check = std::any_of(
+                rejected.begin(), rejected.end(),
+                [&reach](const RectArea &r) { return overlap(reach, r); });
+            accepted = insert_word(w, check, cursor);
+        } else if (verdicts[i] == RECHECK) {
+            accepted = insert_word(w, true, cursor);
+        } else if (accepted) {
+            insert_word(w, false, cursor);
+        }
+        CROSSWORDS_STAT(count(accepted ? WORDS_INSERTED : WORDS_REJECTED));
+        if (!accepted)
+            rejected.push_back(w.rect_area());
     }
     return *this;
 }
 
+size_t Crossword::rendered_size(const RectArea &window) {
+    return (window.size().second + 2) * (2 * window.size().first + 4);
+}
+
+void Crossword::render_window(const RectArea &window, char *out) const {
+    CROSSWORDS_STAT(StatsScope scope(*this, RENDER_TIME));
+    size_t row_size = 2 * window.size().first + 4;
+    size_t rows = window.size().second + 2;
+    blank_row(out, row_size);
+    std::copy_n(out, row_size, out + (rows - 1) * row_size);
+    if (!window.empty())
+        render_rows(window, out + row_size);
+}
+
+// Rows are laid out blank, then filled from the letters of the cells, read
+// a tile row at a time from every layer as letter_at reads them.
+void Crossword::render_rows(const RectArea &window, char *out) const {
+    constexpr size_t SIDE = CellIndex::TILE_SIDE;
+    size_t row_size = 2 * window.size().first + 4;
+    size_t rows = window.size().second;
+    blank_row(out, row_size);
+    for (size_t row = 1; row < rows; row++)
+        std::copy_n(out, row_size, out + row * row_size);
+    if (!store->checked) {
+        render_words(window, out);
+        return;
+    }
+
+    pos_t lt = window.get_left_top();
+    pos_t rb = window.get_right_bottom();
+    // Column of tiles by column of tiles, so that the cursors stay on a tile
+    // for all of its rows.
+    LayerCursors cursors;
+    alignas(16) char cells[SIDE];
+    for (cord_t x = lt.first & ~(SIDE - 1);; x += SIDE) {
+        size_t first = std::max(x, lt.first) - x;
+        size_t last = std::min(rb.first - x, SIDE - 1);
+        for (cord_t y = lt.second;; y++) {
+            std::fill(cells, cells + SIDE, '\0');
+            size_t depth = 0;
+            for (const WordStore *layer = store.get(); layer != nullptr;
+                 layer = layer->parent.get(), depth++) {
+                CROSSWORDS_STAT(count(LETTER_LOOKUPS));
+                layer->cells.fill_line({x, y}, H, cells, cursors[depth]);
+            }
+            if (store->parent != nullptr)
+                CellIndex::clear_blanks(cells);
+            char *row = out + (y - lt.second) * row_size;
+            for (size_t i = first; i <= last; i++) {
+                if (cells[i] != '\0')
+                    row[2 * (x + i - lt.first) + 2] =
+                        Word::is_letter(cells[i]) ? cells[i] : DEFAULT_CHAR;
+            }
+            if (y == rb.second)
+                break;
+        }
+        if (rb.first - x < SIDE)
+            break;
+    }
+}
+
+// Words inserted unchecked may disagree on the letter of a cell, which then
+// holds the letter of the last one. operator<< draws the horizontal words
+// over the vertical ones instead, and so do the rows swept here.
+void Crossword::render_words(const RectArea &window, char *out) const {
+    size_t row_size = 2 * window.size().first + 4;
+    pos_t lt = window.get_left_top();
+    pos_t rb = window.get_right_bottom();
+    std::vector<const Word *> h_words, v_words;
+    for_each_word_in(window, [&h_words, &v_words](const Word &w) {
+        (w.get_orientation() == H ? h_words : v_words).push_back(&w);
+    });
+    auto by_row = [](const Word *w1, const Word *w2) {
+        return w1->get_start_position().second <
+               w2->get_start_position().second;
+    };
+    std::stable_sort(h_words.begin(), h_words.end(), by_row);
+    std::stable_sort(v_words.begin(), v_words.end(), by_row);
+    auto next_h = h_words.begin(), next_v = v_words.begin();
+    std::vector<const Word *> active;
+
+    for (cord_t y = lt.second;; y++) {
+        char *row = out + (y - lt.second) * row_size;
+        auto draw = [row, &lt](pos_t pos, char letter) {
+            row[2 * (pos.first - lt.first) + 2] =
+                Word::is_letter(letter) ? letter : DEFAULT_CHAR;
+        };
+        for (; next_v != v_words.end() &&
+               (*next_v)->get_start_position().second <= y;
+             next_v++)
+            active.push_back(*next_v);
+        size_t kept = 0;
+        for (const Word *w : active) {
+            draw({w->get_start_position().first, y},
+                 w->at(y - w->get_start_position().second));
+            if (w->get_end_position().second != y)
+                active[kept++] = w;
+        }
+        active.resize(kept);
+        for (; next_h != h_words.end() &&
+               (*next_h)->get_start_position().second == y;
+             next_h++) {
+            const Word *w = *next_h;
+            cord_t from = std::max(w->get_start_position().first, lt.first);
+            cord_t to = std::min(w->get_end_position().first, rb.first);
+            for (cord_t x = from; x <= to; x++)
+                draw({x, y}, w->at(x - w->get_start_position().first));
+        }
+        if (y == rb.second)
+            break;
+    }
+}
+
+void Crossword::render(std::ostream &os, RectArea window, bool clip) const {
+    if (clip)
+        window *= area;
+    std::string out(rendered_size(window), '\0');
+    render_window(window, out.data());
+    os.write(out.data(), out.size());
+}
+
+size_t Crossword::render(RectArea window, char *buffer, size_t size,
+                         bool clip) const {
+    if (clip)
+        window *= area;
+    size_t needed = rendered_size(window);
+    if (needed <= size)
+        render_window(window, buffer);
+    return needed;
+}
+
+void Crossword::set_render_cache_limit(size_t bytes) {
+    render_cache_limit = bytes;
+    if (render_cache.text.size() > bytes)
+        render_cache = {};
+}
+
+void Crossword::mark_rows(cord_t top, cord_t bottom) {
+    if (render_cache.dirty.empty())
+        return;
+    cord_t first = render_cache.area.get_left_top().second;
+    cord_t last = render_cache.area.get_right_bottom().second;
+    if (bottom < first || top > last)
+        return;
+    std::fill(render_cache.dirty.begin() + (std::max(top, first) - first),
+              render_cache.dirty.begin() + (std::min(bottom, last) - first) + 1,
+              true);
+}
+
+// Rows kept from the last rendering are moved to where their line is in the
+// current area. Runs of dirty rows are rendered at once, from the cells:
+// only in a checked crossword do those always agree with the words drawn
+// by operator<<.
+bool Crossword::update_render_cache() const {
+    RenderCache &cache = render_cache;
+    size_t bytes = rendered_size(area);
+    if (area.empty() || !store->checked || bytes > render_cache_limit) {
+        cache = {};
+        return false;
+    }
+    size_t row_size = 2 * area.size().first + 4;
+    size_t rows = area.size().second;
+    pos_t lt = area.get_left_top();
+    pos_t rb = area.get_right_bottom();
+    pos_t cached_lt = cache.area.get_left_top();
+    pos_t cached_rb = cache.area.get_right_bottom();
+
+    if (cache.text.empty() || cache.background != CROSSWORD_BACKGROUND ||
+        cached_lt.first != lt.first || cached_rb.first != rb.first) {
+        cache.text.assign(bytes, '\0');
+        cache.dirty.assign(rows, true);
+    } else if (cached_lt.second != lt.second ||
+               cached_rb.second != rb.second) {
+        std::string text(bytes, '\0');
+        std::vector<char> dirty(rows, true);
+        cord_t top = std::max(lt.second, cached_lt.second);
+        cord_t bottom = std::min(rb.second, cached_rb.second);
+        if (top <= bottom) {
+            size_t kept = bottom - top + 1;
+            std::copy_n(cache.text.data() + (top - cached_lt.second + 1) *
+                                                row_size,
+                        kept * row_size,
+                        text.data() + (top - lt.second + 1) * row_size);
+            std::copy_n(cache.dirty.begin() + (top - cached_lt.second), kept,
+                        dirty.begin() + (top - lt.second));
+        }
+        cache.text = std::move(text);
+        cache.dirty = std::move(dirty);
+    }
+    cache.area = area;
+    cache.background = CROSSWORD_BACKGROUND;
+    blank_row(cache.text.data(), row_size);
+    std::copy_n(cache.text.data(), row_size,
+                cache.text.data() + (rows + 1) * row_size);
+
+    for (size_t first = 0; first < rows;) {
+        if (!cache.dirty[first]) {
+            first++;
+            continue;
+        }
+        size_t last = first;
+        while (last + 1 < rows && cache.dirty[last + 1])
+            last++;
+        render_rows(RectArea({lt.first, lt.second + first},
+                             {rb.first, lt.second + last}),
+                    cache.text.data() + (first + 1) * row_size);
+        std::fill(cache.dirty.begin() + first, cache.dirty.begin() + last + 1,
+                  false);
+        first = last + 1;
+    }
+    return true;
+}
+
+std::unique_ptr<const Crossword> Crossword::frozen_copy() const {
+    auto copy = std::make_unique<Crossword>(*this);
+    std::lock_guard<std::mutex> lock(render_lock);
+    if (update_render_cache())
+        copy->render_cache = render_cache;
+    copy->render_frozen = true;
+    return copy;
+}
+
 std::ostream &operator<<(std::ostream &os, const Crossword &crossword) {
+    CROSSWORDS_STAT(Crossword::StatsScope scope(crossword,
+                                                Crossword::RENDER_TIME));
+    const Crossword::RenderCache &cache = crossword.render_cache;
+    if (crossword.render_frozen) {
+        if (!cache.text.empty() && cache.background == CROSSWORD_BACKGROUND)
+            return os.write(cache.text.data(), cache.text.size());
+    } else {
+        std::unique_lock<std::mutex> lock(crossword.render_lock,
+                                          std::try_to_lock);
+        if (lock.owns_lock() && crossword.update_render_cache())
+            return os.write(cache.text.data(), cache.text.size());
+    }
+
+    // Rows are swept top to bottom: horizontal words come straight from
+    // h_words, vertical ones are kept on an active list while they span the
+    // current row. Each finished row is written out as a single block.
     pos_t const &lt = crossword.area.get_left_top();
     pos_t const &rb = crossword.area.get_right_bottom();
-    auto print_empty_line = [&lt, &rb, &os]() {
-        for (cord_t i = lt.first; i <= rb.first; i++)
-            os << CROSSWORD_BACKGROUND << ' ';
-        os << CROSSWORD_BACKGROUND << ' ' << CROSSWORD_BACKGROUND << '\n';
+    size_t width = crossword.area.size().first;
+
+    std::string blank(2 * width + 4, ' ');
+    for (size_t i = 0; i < blank.size(); i += 2)
+        blank[i] = CROSSWORD_BACKGROUND;
+    blank.back() = '\n';
+    auto column_of = [&lt](cord_t x) { return 2 * (x - lt.first) + 2; };
+    auto printable = [](char letter) {
+        return Word::is_letter(letter) ? letter : DEFAULT_CHAR;
     };
 
-    print_empty_line();
-    for (cord_t i = lt.second; i <= rb.second; i++) {
-        pos_t cur = pos_t(lt.first, i);
-
-        os << CROSSWORD_BACKGROUND << ' ';
-        while (cur.first <= rb.first) {
-            std::optional<char> letter = crossword.letter_at(cur);
-            if (letter.has_value()) {
-                os << (isalpha(letter.value()) ? letter.value() : DEFAULT_CHAR);
-            } else {
-                os << CROSSWORD_BACKGROUND;
+    os.write(blank.data(), blank.size());
+    if (!crossword.area.empty()) {
+        using h_iterator = WordStore::h_set_t::const_iterator;
+        std::vector<std::pair<h_iterator, h_iterator>> h_words;
+        std::vector<const Word *> v_words;
+        for (const WordStore *layer = crossword.store.get(); layer != nullptr;
+             layer = layer->parent.get()) {
+            h_words.emplace_back(layer->h_words.begin(), layer->h_words.end());
+            std::copy_if(layer->v_words.begin(), layer->v_words.end(),
+                         std::back_inserter(v_words), [&](const Word *w) {
+                             return !crossword.store->hides(w);
+                         });
+        }
+        std::stable_sort(v_words.begin(), v_words.end(),
+                         [](const Word *w1, const Word *w2) {
+                             return w1->get_start_position().second <
+                                    w2->get_start_position().second;
+                         });
+        auto next_v = v_words.begin();
+        std::vector<const Word *> active;
+        std::string row;
+
+        for (cord_t y = lt.second;; y++) {
+            row = blank;
+            for (; next_v != v_words.end() &&
+                   (*next_v)->get_start_position().second == y;
+                 next_v++)
+                active.push_back(*next_v);
+            // Kept in order, so that of vertical words inserted unchecked
+            // over each other, the one starting lower is drawn last.
+            size_t kept = 0;
+            for (const Word *w : active) {
+                row[column_of(w->get_start_position().first)] =
+                    printable(w->at(y - w->get_start_position().second));
+                if (w->get_end_position().second != y)
+                    active[kept++] = w;
+            }
+            active.resize(kept);
+            for (auto &[next_h, end_h] : h_words) {
+                // Words of parent layers erased since may start above the
+                // area.
+                while (next_h != end_h &&
+                       (*next_h)->get_start_position().second < y)
+                    next_h++;
+                for (; next_h != end_h &&
+                       (*next_h)->get_start_position().second == y;
+                     next_h++) {
+                    const Word *w = *next_h;
+                    if (crossword.store->hides(w))
+                        continue;
+                    size_t column = column_of(w->get_start_position().first);
+                    for (size_t i = 0; i < w->length(); i++, column += 2)
+                        row[column] = printable(w->at(i));
+                }
             }
-            os << ' ';
+            os.write(row.data(), row.size());
 
-            cur.first++;
+            if (y == rb.second)
+                break;
         }
-        os << CROSSWORD_BACKGROUND << '\n';
     }
-    print_empty_line();
+    os.write(blank.data(), blank.size());
 
     return os;
 }
 
 Crossword &Crossword::operator=(const Crossword &other) {
-    delete_words();
-    words.clear();
-    h_words.clear();
-    v_words.clear();
+    store = other.store;
     area = other.area;
-
-    for (Word *w : other.words)
-        insert_word(*w, false);
-
+    journal.clear();
+    journal_cells.clear();
+    journal_roots.clear();
+    checkpoints.clear();
+    render_cache = {};
+    render_frozen = false;
+    render_cache_limit = other.render_cache_limit;
     return *this;
 }
 
-Crossword &Crossword::operator=(Crossword &&other) {
-    delete_words();
-    words.swap(other.words);
-    h_words.swap(other.h_words);
-    v_words.swap(other.v_words);
+Crossword &Crossword::operator=(Crossword &&other) noexcept {
+    store.swap(other.store);
+    other.store = empty_store();
     area = other.area;
     other.area = DEFAULT_EMPTY_RECT_AREA;
+    journal = std::move(other.journal);
+    journal_cells = std::move(other.journal_cells);
+    journal_roots = std::move(other.journal_roots);
+    checkpoints = std::move(other.checkpoints);
+    erasures = other.erasures;
+    other.journal.clear();
+    other.journal_cells.clear();
+    other.journal_roots.clear();
+    other.checkpoints.clear();
+    render_cache = {};
+    render_frozen = false;
+    render_cache_limit = other.render_cache_limit;
     return *this;
 }
+
+// Lines are cut out of chunks filled by read(buffer, capacity, result),
+// which returns 0 at the end of input and sets result.error if reading
+// fails. The bytes read past a malformed line are handed to unread. Each
+// chunk is upper-cased in one go, which also leaves the orientation in upper
+// case. A line cut by the end of a chunk is moved to the front of the
+// buffer, which grows only for lines longer than itself.
+template <typename Read, typename Unread>
+ImportResult Crossword::import_chunks(Read &&read, Unread &&unread) {
+    CROSSWORDS_STAT(StatsScope scope(*this, INSERT_TIME));
+    ImportResult result;
+    make_writable();
+    InsertCursor cursor;
+    std::vector<char> buffer(IMPORT_CHUNK);
+    size_t kept = 0;
+    while (true) {
+        if (kept == buffer.size())
+            buffer.resize(2 * buffer.size());
+        size_t got = read(buffer.data() + kept, buffer.size() - kept, result);
+        if (!result.error.empty())
+            return result;
+        char *first = buffer.data();
+        char *last = first + kept + got;
+        upper_case(first + kept, last);
+
+        while (first != last) {
+            char *end = static_cast<char *>(std::memchr(first, '\n', last - first));
+            if (end == nullptr && got != 0)
+                break;
+            if (end == nullptr)
+                end = last;
+            if (!import_line(std::string_view(first, end - first), cursor,
+                             result)) {
+                unread(last - (end == last ? last : end + 1));
+                return result;
+            }
+            first = end == last ? last : end + 1;
+        }
+        if (got == 0)
+            return result;
+        kept = last - first;
+        std::memmove(buffer.data(), first, kept);
+    }
+}
+
+// Returns false if the line is malformed.
+bool Crossword::import_line(std::string_view line, InsertCursor &cursor,
+                            ImportResult &result) {
+    result.lines++;
+    auto fail = [&result](const char *error) {
+        result.error_line = result.lines;
+        result.error = error;
+        return false;
+    };
+    auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+    auto skip_spaces = [&line, &is_space]() {
+        size_t spaces = 0;
+        while (spaces < line.size() && is_space(line[spaces]))
+            spaces++;
+        line.remove_prefix(spaces);
+        return spaces;
+    };
+    auto read_cord = [&line](cord_t &cord) {
+        auto [end, ec] =
+            std::from_chars(line.data(), line.data() + line.size(), cord);
+        line.remove_prefix(end - line.data());
+        return ec == std::errc();
+    };
+    while (!line.empty() && is_space(line.back()))
+        line.remove_suffix(1);
+
+    cord_t x, y;
+    skip_spaces();
+    if (line.empty())
+        return true;
+    if (!read_cord(x) || skip_spaces() == 0 || !read_cord(y) ||
+        skip_spaces() == 0)
+        return fail("expected coordinates x y");
+    if (line.empty() || (line[0] != 'H' && line[0] != 'V'))
+        return fail("expected orientation H or V");
+    orientation_t orientation = line[0] == 'H' ? H : V;
+    line.remove_prefix(1);
+    if (skip_spaces() == 0 || line.empty())
+        return fail("expected a word");
+
+    Word w({x, y}, orientation, line);
+    if (w.get_end_position() < w.get_start_position())
+        return fail("word out of range");
+    bool inserted = insert_word(w, true, cursor);
+    CROSSWORDS_STAT(count(inserted ? WORDS_INSERTED : WORDS_REJECTED));
+    if (!inserted)
+        result.rejected.push_back(result.lines);
+    return true;
+}
+
+// Reading stops with eofbit and failbit set at the end of the input. Bytes
+// read past a malformed line are put back by seeking, and the stream is
+// left failed, as by a failed extraction.
+ImportResult Crossword::import_words(std::istream &is) {
+    auto read = [&is](char *buffer, size_t capacity,
+                      ImportResult &result) -> size_t {
+        bool reading = false;
+        try {
+            std::istream::sentry sentry(is, true);
+            if (!sentry) {
+                if (is.bad() || !is.eof())
+                    result.error = "cannot read the input";
+                return 0;
+            }
+            reading = true;
+            is.read(buffer, capacity);
+            if (is.bad())
+                result.error = "error reading the input";
+        } catch (const std::ios_base::failure &e) {
+            // Streams may throw at the end of input too.
+            if (is.bad() || !is.eof())
+                result.error = e.what();
+        }
+        return reading ? is.gcount() : 0;
+    };
+    auto unread = [&is](size_t bytes) {
+        try {
+            is.clear(is.rdstate() & ~(std::ios::eofbit | std::ios::failbit));
+            is.seekg(-static_cast<std::streamoff>(bytes), std::ios::cur);
+            is.setstate(std::ios::failbit);
+        } catch (const std::ios_base::failure &) {
+        }
+    };
+    return import_chunks(read, unread);
+}
+
+ImportResult Crossword::import_words(std::string_view text) {
+    make_writable();
+    store->reserve(std::count(text.begin(), text.end(), '\n') + 1);
+    auto read = [&text](char *buffer, size_t capacity, ImportResult &) {
+        size_t count = std::min(capacity, text.size());
+        std::copy_n(text.data(), count, buffer);
+        text.remove_prefix(count);
+        return count;
+    };
+    return import_chunks(read, [](size_t) {});
+}
+
+ImportResult Crossword::import_file(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        ImportResult result;
+        result.error = "cannot open " + path;
+        return result;
+    }
+    return import_words(file);
+}
+
+// Words of all layers are written in index order, merged layer by layer,
+// and their letters gathered to follow them, so a single pass suffices.
+void Crossword::save(std::ostream &os) const {
+    using Header = CrosswordView::Header;
+    using Record = CrosswordView::Record;
+
+    Header header = {};
+    std::copy_n(CrosswordView::MAGIC, sizeof(header.magic), header.magic);
+    header.version = CrosswordView::VERSION;
+    header.byte_order = CrosswordView::ORDER_MARK;
+    header.flags = store->checked ? CrosswordView::CHECKED : 0;
+    CrosswordView::set_rect(header.area, area);
+    RectArea unstored = DEFAULT_EMPTY_RECT_AREA;
+    for (const WordStore *layer = store.get(); layer != nullptr;
+         layer = layer->parent.get()) {
+        if (!layer->unstored.empty()) {
+            unstored.embrace(layer->unstored.get_left_top());
+            unstored.embrace(layer->unstored.get_right_bottom());
+        }
+    }
+    CrosswordView::set_rect(header.unstored, unstored);
+    header.h_count = word_count().first;
+    header.v_count = word_count().second;
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    std::string letters;
+    std::vector<std::pair<const Word *, uint64_t>> indices;
+    indices.reserve(header.h_count + header.v_count);
+    auto write_words = [this, &os, &letters, &indices](auto word_set_of) {
+        using iterator_t = decltype(word_set_of(*store).begin());
+        std::array<std::pair<iterator_t, iterator_t>, WordStore::MAX_DEPTH> runs;
+        size_t layers = 0;
+        for (const WordStore *layer = store.get(); layer != nullptr;
+             layer = layer->parent.get()) {
+            runs[layers++] = {word_set_of(*layer).begin(),
+                              word_set_of(*layer).end()};
+        }
+        auto cmp = word_set_of(*store).key_comp();
+        while (true) {
+            size_t next = layers;
+            for (size_t i = 0; i < layers; i++) {
+                if (runs[i].first != runs[i].second &&
+                    (next == layers ||
+                     cmp(*runs[i].first, *runs[next].first)))
+                    next = i;
+            }
+            if (next == layers)
+                break;
+            const Word *w = *runs[next].first++;
+            if (store->hides(w))
+                continue;
+            Record record = {w->get_start_position().first,
+                             w->get_start_position().second, letters.size(),
+                             w->layout};
+            indices.push_back({w, indices.size()});
+            letters.append(w->letters(), w->length());
+            os.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        }
+    };
+    write_words([](const WordStore &layer) -> auto & { return layer.h_words; });
+    write_words([](const WordStore &layer) -> auto & { return layer.v_words; });
+
+    // Whether a word collides depends on the words inserted before it, so
+    // the order of insertion is kept for rebuilding the crossword.
+    std::sort(indices.begin(), indices.end());
+    store->for_each_word([&os, &indices](const Word &w) {
+        uint64_t index = std::lower_bound(indices.begin(), indices.end(),
+                                          std::make_pair(&w, uint64_t(0)))
+                             ->second;
+        os.write(reinterpret_cast<const char *>(&index), sizeof(index));
+    });
+    os.write(letters.data(), letters.size());
+}
+
+std::optional<Crossword> Crossword::load(std::istream &is) {
+    using Record = CrosswordView::Record;
+
+    CrosswordView::Header header;
+    if (!is.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        !CrosswordView::valid_header(header, MAX_COORDINATE / sizeof(Record)))
+        return {};
+    std::vector<Record> records;
+    for (uint64_t i = 0; i < header.h_count + header.v_count; i++) {
+        Record record;
+        if (!is.read(reinterpret_cast<char *>(&record), sizeof(record)))
+            return {};
+        records.push_back(record);
+    }
+    std::vector<uint64_t> order;
+    std::vector<bool> seen(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        uint64_t index;
+        if (!is.read(reinterpret_cast<char *>(&index), sizeof(index)) ||
+            index >= records.size() || seen[index])
+            return {};
+        seen[index] = true;
+        order.push_back(index);
+    }
+    std::string letters(std::istreambuf_iterator<char>(is), {});
+
+    Crossword cr;
+    bool check = header.flags & CrosswordView::CHECKED;
+    cr.store->reserve(records.size());
+    InsertCursor cursor;
+    for (uint64_t i : order) {
+        const Record &record = records[i];
+        std::string_view content = CrosswordView::letters_of(record, letters);
+        orientation_t orientation = i < header.h_count ? H : V;
+        if (content.empty() || (record.layout & 1) != orientation)
+            return {};
+        Word w({record.x, record.y}, orientation, content);
+        if (w.get_end_position() < w.get_start_position() ||
+            !cr.insert_word(w, check, cursor))
+            return {};
+    }
+    cr.store->checked = check || records.empty();
+    // The area may reach beyond the words: repeated words with no storage of
+    // their own still widen it, and what they cover is saved on its own.
+    RectArea unstored = CrosswordView::rect_of(header.unstored);
+    if (!unstored.empty()) {
+        cr.store->unstored.embrace(unstored.get_left_top());
+        cr.store->unstored.embrace(unstored.get_right_bottom());
+        cr.area.embrace(unstored.get_left_top());
+        cr.area.embrace(unstored.get_right_bottom());
+    }
+    RectArea area = CrosswordView::rect_of(header.area);
+    if (area.empty() != cr.area.empty() ||
+        (!area.empty() && (area.get_left_top() != cr.area.get_left_top() ||
+                           area.get_right_bottom() !=
+                               cr.area.get_right_bottom())))
+        return {};
+    return cr;
+}
+
+// CrosswordView implementation:
+
+CrosswordView::CrosswordView(void *mapped, size_t mapped_bytes)
+    : data(mapped), bytes(mapped_bytes),
+      header(static_cast<const Header *>(mapped)),
+      h_words(reinterpret_cast<const Record *>(header + 1)),
+      v_words(h_words + header->h_count) {
+    const char *end = reinterpret_cast<const char *>(v_words + header->v_count) +
+                      (header->h_count + header->v_count) * sizeof(uint64_t);
+    letters = std::string_view(end, static_cast<const char *>(mapped) +
+                                        mapped_bytes - end);
+}
+
+bool CrosswordView::valid_header(const Header &header, size_t words) {
+    return std::equal(header.magic, header.magic + sizeof(header.magic),
+                      MAGIC) &&
+           header.version == VERSION && header.byte_order == ORDER_MARK &&
+           header.h_count <= words && header.v_count <= words - header.h_count;
+}
+
+// The letters of a record, or nothing if they lie outside of the letters.
+std::string_view CrosswordView::letters_of(const Record &record,
+                                           std::string_view letters) {
+    uint64_t length = record.layout >> 1;
+    if (record.letters > letters.size() ||
+        length > letters.size() - record.letters)
+        return {};
+    return letters.substr(record.letters, length);
+}
+
+std::optional<CrosswordView> CrosswordView::map(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return {};
+    struct stat st;
+    void *mapped = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Header))
+        mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return {};
+
+    size_t words =
+        (st.st_size - sizeof(Header)) / (sizeof(Record) + sizeof(uint64_t));
+    if (!valid_header(*static_cast<const Header *>(mapped), words)) {
+        munmap(mapped, st.st_size);
+        return {};
+    }
+    return CrosswordView(mapped, st.st_size);
+}
+
+CrosswordView::CrosswordView(CrosswordView &&other)
+    : data(std::exchange(other.data, nullptr)), bytes(other.bytes),
+      header(other.header), h_words(other.h_words), v_words(other.v_words),
+      letters(other.letters) {}
+
+CrosswordView::~CrosswordView() {
+    if (data != nullptr)
+        munmap(data, bytes);
+}
+
+dim_t CrosswordView::size() const {
+    return rect_of(header->area).size();
+}
+
+// The word holding a letter at pos is the last one starting at or before
+// it in the order of its index.
+std::optional<char> CrosswordView::letter_at(pos_t pos) const {
+    auto find = [this, pos](const Record *first, const Record *last,
+                            bool horizontal) -> std::optional<char> {
+        auto key = [horizontal](cord_t x, cord_t y) {
+            return horizontal ? pos_t(y, x) : pos_t(x, y);
+        };
+        const Record *it = std::upper_bound(
+            first, last, key(pos.first, pos.second),
+            [&key](pos_t p, const Record &r) { return p < key(r.x, r.y); });
+        if (it == first)
+            return {};
+        --it;
+        std::string_view content = letters_of(*it, letters);
+        pos_t offset = key(pos.first - it->x, pos.second - it->y);
+        if (offset.first != 0 || offset.second >= content.size())
+            return {};
+        return content[offset.second];
+    };
+    if (std::optional<char> letter =
+            find(h_words, h_words + header->h_count, true))
+        return letter;
+    return find(v_words, v_words + header->v_count, false);
+}
+
+// The words are inserted in the order saved with them. If that order is
+// damaged, nothing vouches for the checked flag.
+Crossword CrosswordView::to_crossword() const {
+    size_t count = header->h_count + header->v_count;
+    const uint64_t *order =
+        reinterpret_cast<const uint64_t *>(v_words + header->v_count);
+    std::vector<bool> seen(count);
+    bool ordered = true;
+    for (size_t i = 0; i < count && ordered; i++) {
+        ordered = order[i] < count && !seen[order[i]];
+        if (ordered)
+            seen[order[i]] = true;
+    }
+    bool check = ordered && header->flags & CHECKED;
+
+    Crossword cr;
+    cr.store->reserve(count);
+    Crossword::InsertCursor cursor;
+    for (size_t i = 0; i < count; i++) {
+        const Record &record = h_words[ordered ? order[i] : i];
+        std::string_view content = letters_of(record, letters);
+        if (content.empty())
+            content = DEFAULT_WORD;
+        Word w({record.x, record.y}, &record < v_words ? H : V, content);
+        if (!check || !cr.insert_word(w, true, cursor)) {
+            check = false;
+            cr.insert_word(w, false, cursor);
+        }
+    }
+    cr.store->checked = check || count == 0;
+    RectArea unstored = rect_of(header->unstored);
+    if (!unstored.empty()) {
+        cr.store->unstored.embrace(unstored.get_left_top());
+        cr.store->unstored.embrace(unstored.get_right_bottom());
+        cr.area.embrace(unstored.get_left_top());
+        cr.area.embrace(unstored.get_right_bottom());
+    }
+    return cr;
+}
@@ -2,10 +2,27 @@
 #define CROSSWORDS_H
 
 #include <iostream>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <optional>
+#include <ranges>
 
 enum orientation_t : bool {
 	H, V
@@ -22,44 +39,86 @@ constexpr char DEFAULT_CHAR = '?';
 constexpr std::string DEFAULT_WORD = "?";
 extern char CROSSWORD_BACKGROUND;
 
-extern const RectArea DEFAULT_EMPTY_RECT_AREA;
+// Cell holding the letter at offset of a word starting at start.
+constexpr pos_t letter_position(pos_t start, orientation_t orientation,
+	size_t offset) {
+	if (orientation == H)
+		return {start.first + offset, start.second};
+	return {start.first, start.second + offset};
+}
 
+// Letters of words up to INLINE_LETTERS long are kept inside the word.
+// Longer ones are allocated from the memory resource the word was built
+// with, which is remembered next to them.
 class Word {
 	private:
+		static constexpr size_t INLINE_LETTERS = 16;
+
 		pos_t wordStart;
-		orientation_t orientation;
-		std::string content;
+		// The orientation in the lowest bit, the number of letters above it.
+		size_t layout;
+		union {
+			char inlineLetters[INLINE_LETTERS];
+			struct {
+				char* letters;
+				std::pmr::memory_resource* resource;
+			} outOfLine;
+		};
 
 		std::optional<char> at(pos_t pos) const;
-		pos_t pos_of_letter(size_t offset) const;
+		inline bool is_inline() const {
+			return length() <= INLINE_LETTERS;
+		}
+		inline const char* letters() const {
+			return is_inline() ? inlineLetters : outOfLine.letters;
+		}
+		void assign(const Word& word, std::pmr::memory_resource* resource);
+		void take(Word& word) noexcept;
+		void release();
+		// Takes the letters as they are, already in upper case.
+		Word(pos_t start, orientation_t wordOrientation, std::string_view wordLetters);
 	public:
+		using allocator_type = std::pmr::polymorphic_allocator<char>;
+
 		Word(size_t x, size_t y, orientation_t wordOrientation, std::string&& wordContent);
 		Word(const Word& word);
-		Word(Word&& word);
+		Word(const Word& word, const allocator_type& alloc);
+		Word(Word&& word) noexcept;
+		~Word();
 		Word& operator=(const Word& word);
-		Word& operator=(Word&& word);
-		inline pos_t get_start_position() const {
+		Word& operator=(Word&& word) noexcept;
+		constexpr pos_t get_start_position() const {
 			return wordStart;
 		}
-		pos_t get_end_position() const;
-		inline orientation_t get_orientation() const {
-			return orientation;
+		constexpr pos_t pos_of_letter(size_t offset) const {
+			return letter_position(wordStart, get_orientation(), offset);
+		}
+		constexpr pos_t get_end_position() const {
+			return pos_of_letter(length() - 1);
+		}
+		constexpr orientation_t get_orientation() const {
+			return static_cast<orientation_t>(layout & 1);
 		}
 		char at(size_t pos) const;
-		inline size_t length() const {
-			return content.size();
+		constexpr size_t length() const {
+			return layout >> 1;
 		}
 		std::weak_ordering operator<=>(const Word& word) const;
 		bool operator==(const Word& word) const;
 		bool operator!=(const Word& word) const;
-		RectArea rect_area() const;
+		constexpr RectArea rect_area() const;
 
-		static bool are_letters_the_same(char l1, char l2) {
-			return (!isalpha(l1) && !isalpha(l2))
-				|| (isalpha(l1) && isalpha(l2) && l1 == l2);
+		static constexpr bool is_letter(char c) {
+			return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+		}
+		static constexpr bool are_letters_the_same(char l1, char l2) {
+			return (!is_letter(l1) && !is_letter(l2))
+				|| (is_letter(l1) && is_letter(l2) && l1 == l2);
 		}
 
 		friend class Crossword;
+		friend class CrosswordView;
+		friend class CrosswordFiller;
 };
 
 class RectArea {
@@ -67,88 +126,1052 @@ class RectArea {
 		pos_t leftUpper;
 		pos_t rightBottom;
 		
-		bool pointInRect(pos_t point) const;
-		bool rectInRect(RectArea rectArea) const;
+		constexpr bool pointInRect(pos_t point) const {
+			return point.first >= leftUpper.first
+				&& point.second >= leftUpper.second
+				&& point.first <= rightBottom.first
+				&& point.second <= rightBottom.second;
+		}
 	public:
-		RectArea(pos_t left_top, pos_t right_bottom);
-		RectArea(const RectArea& rectArea);
-		RectArea(RectArea&& rectArea);
-		RectArea& operator=(const RectArea& rectArea);
-		RectArea& operator=(RectArea&& rectArea);
-		inline pos_t get_left_top() const {
+		constexpr RectArea(pos_t left_top, pos_t right_bottom)
+			: leftUpper(left_top), rightBottom(right_bottom) {}
+		constexpr RectArea(const RectArea& rectArea)
+			: leftUpper(rectArea.leftUpper), rightBottom(rectArea.rightBottom) {}
+		constexpr RectArea(RectArea&& rectArea)
+			: leftUpper(std::move(rectArea.leftUpper)),
+			rightBottom(std::move(rectArea.rightBottom)) {}
+		constexpr RectArea& operator=(const RectArea& rectArea) {
+			leftUpper = rectArea.leftUpper;
+			rightBottom = rectArea.rightBottom;
+			return *this;
+		}
+		constexpr RectArea& operator=(RectArea&& rectArea) {
+			leftUpper = std::move(rectArea.leftUpper);
+			rightBottom = std::move(rectArea.rightBottom);
+			return *this;
+		}
+		constexpr pos_t get_left_top() const {
 			return leftUpper;
 		}
-		inline pos_t get_right_bottom() const {
+		constexpr pos_t get_right_bottom() const {
 			return rightBottom;
 		}
-		inline pos_t get_left_bottom() const {
+		constexpr pos_t get_left_bottom() const {
 			return {leftUpper.first, rightBottom.second};
 		}
-		inline pos_t get_right_top() const {
+		constexpr pos_t get_right_top() const {
 			return {rightBottom.first, leftUpper.second};
 		}
-		inline void set_left_top(pos_t point) {
+		constexpr void set_left_top(pos_t point) {
 			leftUpper = point;
 		}
-		inline void set_right_bottom(pos_t point) {
+		constexpr void set_right_bottom(pos_t point) {
 			rightBottom = point;
 		}
-		inline void set_left_bottom(pos_t point) {
+		constexpr void set_left_bottom(pos_t point) {
 			leftUpper.first = point.first;
 			rightBottom.second = point.second;
 		}
-		inline void set_right_top(pos_t point) {
+		constexpr void set_right_top(pos_t point) {
 			rightBottom.first = point.first;
 			leftUpper.second = point.second;
 		}
-		const RectArea operator*(const RectArea& rectArea) const;
-		RectArea& operator*=(const RectArea& rectArea);
-		dim_t size() const;
-		inline bool empty() const {
+		constexpr const RectArea operator*(const RectArea& rectArea) const {
+			return RectArea(*this) *= rectArea;
+		}
+		constexpr RectArea& operator*=(const RectArea& rectArea) {
+			if (empty())
+				return *this;
+
+			leftUpper = {std::max(leftUpper.first, rectArea.leftUpper.first),
+				std::max(leftUpper.second, rectArea.leftUpper.second)};
+			rightBottom = {std::min(rightBottom.first, rectArea.rightBottom.first),
+				std::min(rightBottom.second, rectArea.rightBottom.second)};
+			if (empty()) {
+				set_left_top({1, 1});
+				set_right_bottom({0, 0});
+			}
+			return *this;
+		}
+		constexpr dim_t size() const {
+			if (empty())
+				return {0, 0};
+
+			size_t width = get_right_top().first - get_left_top().first + 1;
+			size_t height = get_left_bottom().second - get_left_top().second + 1;
+			return {width, height};
+		}
+		constexpr bool empty() const {
 			return
 			leftUpper.first > rightBottom.first ||
 			leftUpper.second > rightBottom.second;
 		}
-		void embrace(pos_t point);
+		constexpr void embrace(pos_t point) {
+			if (pointInRect(point))
+				return;
+
+			if (empty()) {
+				leftUpper = point;
+				rightBottom = point;
+				return;
+			}
+
+			if (point.first < leftUpper.first)
+				leftUpper.first = point.first;
+			else if (point.first > rightBottom.first)
+				rightBottom.first = point.first;
+
+			if (point.second < leftUpper.second)
+				leftUpper.second = point.second;
+			else if (point.second > rightBottom.second)
+				rightBottom.second = point.second;
+		}
 };
 
+inline constexpr RectArea DEFAULT_EMPTY_RECT_AREA = RectArea({1, 1}, {0, 0});
+
+// The cells read by a collision check of a word in rect: rect and the
+// spacing margin of one cell around it, within the plane.
+constexpr RectArea with_margin(const RectArea& rect) {
+	pos_t lt = rect.get_left_top();
+	pos_t rb = rect.get_right_bottom();
+	lt.first -= lt.first > 0;
+	lt.second -= lt.second > 0;
+	rb.first += rb.first < MAX_COORDINATE;
+	rb.second += rb.second < MAX_COORDINATE;
+	return RectArea(lt, rb);
+}
+
+constexpr RectArea Word::rect_area() const {
+	return RectArea(get_start_position(), get_end_position());
+}
+
+// Whether a letter lies right before or right after w.
+template <typename W, typename LetterAt>
+constexpr bool ends_collide(const W& w, LetterAt&& letter_at) {
+	bool horizontal = w.get_orientation() == H;
+	pos_t start = w.get_start_position();
+	cord_t& before = horizontal ? start.first : start.second;
+	if (before > 0) {
+		before--;
+		if (letter_at(start).has_value())
+			return true;
+	}
+	pos_t end = w.get_end_position();
+	cord_t& after = horizontal ? end.first : end.second;
+	if (after < MAX_COORDINATE) {
+		after++;
+		if (letter_at(end).has_value())
+			return true;
+	}
+	return false;
+}
+
+// Whether w breaks the spacing rules against the letters letter_at(pos)
+// finds around it: each letter must match the one in its cell, an empty
+// cell may have no letters beside it across w, and the cells before and
+// after w must be empty. Running over a parallel word is checked apart.
+template <typename W, typename LetterAt>
+constexpr bool collides_with_letters(const W& w, LetterAt&& letter_at) {
+	bool horizontal = w.get_orientation() == H;
+	for (size_t i = 0; i < w.length(); i++) {
+		pos_t pos = w.pos_of_letter(i);
+		std::optional<char> letter = letter_at(pos);
+
+		if (letter.has_value()) {
+			if (!Word::are_letters_the_same(*letter, w.at(i)))
+				return true;
+			continue;
+		}
+		cord_t& across = horizontal ? pos.second : pos.first;
+		if (across > 0) {
+			across--;
+			if (letter_at(pos).has_value())
+				return true;
+			across++;
+		}
+		if (across < MAX_COORDINATE) {
+			across++;
+			if (letter_at(pos).has_value())
+				return true;
+		}
+	}
+
+	return ends_collide(w, letter_at);
+}
+
+// Orders vertical words column by column, and horizontal ones row by row,
+// by their start. Both are transparent, so that words are looked up by
+// a start alone, with no Word to compare with.
 struct vertical_cmp {
-	bool operator()(Word* w1, Word* w2) const;
+	using is_transparent = void;
+
+	constexpr bool operator()(const Word* w1, const Word* w2) const {
+		return w1->get_start_position() < w2->get_start_position();
+	}
+	constexpr bool operator()(const Word* w, pos_t start) const {
+		return w->get_start_position() < start;
+	}
+	constexpr bool operator()(pos_t start, const Word* w) const {
+		return start < w->get_start_position();
+	}
 };
 
 struct horizontal_cmp {
-	bool operator()(Word* w1, Word* w2) const;
+	using is_transparent = void;
+
+	static constexpr pos_t row_major(pos_t pos) {
+		return {pos.second, pos.first};
+	}
+	constexpr bool operator()(const Word* w1, const Word* w2) const {
+		return row_major(w1->get_start_position()) <
+			row_major(w2->get_start_position());
+	}
+	constexpr bool operator()(const Word* w, pos_t start) const {
+		return row_major(w->get_start_position()) < row_major(start);
+	}
+	constexpr bool operator()(pos_t start, const Word* w) const {
+		return row_major(start) < row_major(w->get_start_position());
+	}
+};
+
+// Bulk storage for the words of a single crossword. Words and their letters
+// are carved out of large blocks, which are all released at once when the
+// arena is destroyed. Handles are indices in insertion order and stay valid
+// for the lifetime of the arena.
+class WordArena {
+	public:
+		using handle_t = size_t;
+
+		WordArena();
+		WordArena(const WordArena&) = delete;
+		WordArena& operator=(const WordArena&) = delete;
+
+		handle_t store(const Word& w);
+		void reserve(size_t count);
+		inline Word& operator[](handle_t handle) const {
+			return blocks[handle >> BLOCK_SHIFT][handle & (BLOCK_WORDS - 1)];
+		}
+		inline size_t size() const {
+			return count;
+		}
+		// Forgets the last word stored. Letters it kept outside of the word
+		// stay allocated until the arena goes.
+		inline void pop() {
+			count--;
+		}
+		inline std::pmr::memory_resource* resource() {
+			return &memory;
+		}
+	private:
+		static constexpr size_t BLOCK_SHIFT = 8;
+		static constexpr size_t BLOCK_WORDS = (size_t) 1 << BLOCK_SHIFT;
+
+		std::pmr::monotonic_buffer_resource memory;
+		std::vector<Word*> blocks;
+		size_t count;
+};
+
+// Sparse grid of the letters placed in a crossword. The plane is split into
+// square tiles, allocated on first use and keyed by their tile coordinates,
+// which hold their letters densely. Empty cells are stored as '\0', and
+// cells emptied over the letters of a parent layer as BLANK.
+class CellIndex {
+	public:
+		static constexpr size_t TILE_SHIFT = 4;
+		static constexpr size_t TILE_SIDE = (size_t) 1 << TILE_SHIFT;
+		static constexpr char BLANK = '\x7f';
+
+		explicit CellIndex(std::pmr::memory_resource* resource);
+
+		using tile_t = std::array<char, TILE_SIDE * TILE_SIDE>;
+
+		// Remembers the last tile visited, or that it is missing, so that
+		// a run of accesses within one tile costs a single hash probe. Tiles
+		// are never freed, so a cursor stays valid while the index lives, as
+		// long as no tile it found missing is added through another cursor.
+		class Cursor {
+			private:
+				pos_t key = {0, 0};
+				tile_t* tile = nullptr;
+				bool missing = false;
+
+				friend class CellIndex;
+		};
+
+		std::optional<char> at(pos_t pos) const;
+		std::optional<char> at(pos_t pos, Cursor& cursor) const;
+		void set(pos_t pos, char letter, Cursor& cursor);
+		void erase(pos_t pos, Cursor& cursor);
+		void blank(pos_t pos, Cursor& cursor);
+		void reserve(size_t tiles);
+		// Fills the empty ones among the TILE_SIDE cells of out with the
+		// cells of the line along orientation through pos, within its tile,
+		// from the edge of the tile on. Returns whether the tile exists.
+		bool fill_line(pos_t pos, orientation_t orientation, char* out,
+			Cursor& cursor) const;
+		// Empties the blank ones among the TILE_SIDE cells of line.
+		static void clear_blanks(char* line);
+	private:
+		struct tile_hash {
+			size_t operator()(const pos_t& key) const;
+		};
+
+		const tile_t* find(pos_t pos, Cursor& cursor) const;
+		char& cell(pos_t pos, Cursor& cursor);
+
+		static inline pos_t tile_of(pos_t pos) {
+			return {pos.first >> TILE_SHIFT, pos.second >> TILE_SHIFT};
+		}
+		static inline size_t offset_in_tile(pos_t pos) {
+			return ((pos.second & (TILE_SIDE - 1)) << TILE_SHIFT)
+				| (pos.first & (TILE_SIDE - 1));
+		}
+
+		std::pmr::unordered_map<pos_t, tile_t, tile_hash> tiles;
+};
+
+// One layer of the words of a crossword together with the ordered indexes
+// over them. Copies of a crossword share their layers: a layer is modified
+// only while a single crossword holds it, otherwise new words go to a fresh
+// layer stacked on top. Letters and words are looked up in every layer, so
+// once the stack is MAX_DEPTH layers deep the smaller top layers are merged,
+// and the whole stack is flattened only when the layers above the bottom
+// one hold half as many words as it does. Erased words are only dropped
+// from the indexes; they leave the arena when their layer is merged. Words
+// of a parent layer erased in this one stay in its indexes, and are told
+// apart by erased.
+struct WordStore {
+	using h_set_t = std::pmr::set<Word*, horizontal_cmp>;
+	using v_set_t = std::pmr::set<Word*, vertical_cmp>;
+	// Number of words of the layer reaching each coordinate with one edge,
+	// less the words of parent layers erased in it.
+	using edge_count_t = std::pmr::map<cord_t, ptrdiff_t>;
+	enum edge_t { LEFT, RIGHT, TOP, BOTTOM };
+
+	static constexpr size_t MAX_DEPTH = 8;
+
+	const std::shared_ptr<const WordStore> parent;
+	const size_t depth;
+	// Numbers of horizontal and vertical words in the parent layers.
+	const dim_t base_count;
+	WordArena arena;
+	h_set_t h_words;
+	v_set_t v_words;
+	CellIndex cells;
+	// Whether every word was checked against all words stored before it.
+	bool checked;
+	// Number of one-letter words in this and the parent layers.
+	size_t single_letters;
+	// Left and right edges of horizontal words, top and bottom edges of
+	// vertical ones. The other edges are the first and last words of
+	// h_words and v_words.
+	std::array<edge_count_t, 4> edges;
+	// Extent of words taken for stored ones, as they start at the same
+	// cell, which widen the crossword without storage of their own.
+	RectArea unstored;
+	std::pmr::unordered_set<const Word*> erased;
+	// Numbers of horizontal and vertical words of parent layers erased in
+	// this and the parent layers.
+	dim_t tombstones;
+
+	// A crossing as seen from one of its two words: the other word and the
+	// cell they share.
+	struct Crossing {
+		const Word* word;
+		pos_t cell;
+	};
+	// The crossings found as words were stored in this layer, listed under
+	// both of their words.
+	std::pmr::unordered_map<const Word*, std::pmr::vector<Crossing>> crossings;
+	// Union-find over the words joined by crossings, by size and without
+	// path compression, so that the last unions can be undone. A word with
+	// no parent in any layer is a root, and a root with no size in any
+	// layer a component of its own.
+	std::pmr::unordered_map<const Word*, const Word*> parents;
+	std::pmr::unordered_map<const Word*, size_t> component_sizes;
+	// In this and the parent layers: the crossings, the components, and
+	// for each degree from 1 on, the number of words crossed that often.
+	size_t crossing_count;
+	size_t components;
+	std::pmr::vector<size_t> degree_counts;
+	// Components split by erasures in this layer, after which the unions
+	// recorded before can no longer be undone.
+	size_t splits;
+
+	WordStore();
+	explicit WordStore(std::shared_ptr<const WordStore> parent_layer);
+	void reserve(size_t words);
+	// The stored word with the given start and orientation, if any.
+	const Word* find(pos_t start, orientation_t orientation) const;
+	// The same in this and the parent layers, skipping erased words.
+	const Word* lookup(pos_t start, orientation_t orientation) const;
+	bool is_erased(const Word* w) const;
+	// Whether w, found in the indexes of this or a parent layer, was
+	// erased in a layer above its own.
+	inline bool hides(const Word* w) const {
+		return tombstones != dim_t(0, 0) && is_erased(w);
+	}
+	template <typename F>
+	void for_each_word(F&& f) const;
+
+	template <typename F>
+	void for_each_crossing(const Word* w, F&& f) const {
+		for (const WordStore* layer = this; layer != nullptr;
+				layer = layer->parent.get()) {
+			auto it = layer->crossings.find(w);
+			if (it != layer->crossings.end()) {
+				for (const Crossing& crossing : it->second) {
+					if (!hides(crossing.word))
+						f(crossing);
+				}
+			}
+		}
+	}
+	size_t degree(const Word* w) const;
+	const Word* root(const Word* w) const;
+	size_t component_size(const Word* root) const;
+	// Records that a, stored in this layer, crosses b at cell, and joins
+	// their components. Returns the root put under the other one, or
+	// nothing if they were joined already.
+	const Word* cross(const Word* a, const Word* b, pos_t cell);
+	// Undoes the last union, which put root under another one.
+	void unjoin(const Word* root);
+	// Forgets the crossings of w, stored in this layer, and w itself. With
+	// split, the rest of the component of w is taken apart into the parts
+	// still joined; otherwise w must be alone in its component.
+	void uncross(const Word* w, bool split);
+	void count_degree(size_t from, size_t to);
+};
+
+class CrosswordView;
+
+// Outcome of importing lines of word placements. Lines are numbered from 1.
+struct ImportResult {
+	size_t lines = 0;
+	// Lines with words rejected as colliding.
+	std::vector<size_t> rejected;
+	// What stopped the import, empty if nothing did, and the malformed line
+	// it stopped at, 0 if the input could not be read.
+	std::string error;
+	size_t error_line = 0;
+};
+
+// Work done by a crossword since it was created or its stats were reset.
+// Counting is compiled in only when the whole build defines
+// CROSSWORDS_STATS; otherwise the numbers stay zero and cost nothing.
+struct CrosswordStats {
+	// Letters read from cells and searches in the ordered word indexes.
+	uint64_t letter_lookups = 0;
+	uint64_t word_lookups = 0;
+	uint64_t collision_checks = 0;
+	uint64_t collisions = 0;
+	uint64_t words_inserted = 0;
+	uint64_t words_rejected = 0;
+	// Heap memory taken by the word stores.
+	uint64_t bytes_allocated = 0;
+	std::chrono::nanoseconds insert_time{0};
+	std::chrono::nanoseconds merge_time{0};
+	std::chrono::nanoseconds render_time{0};
 };
 
+#ifdef CROSSWORDS_STATS
+#define CROSSWORDS_STAT(statement) statement
+#else
+#define CROSSWORDS_STAT(statement)
+#endif
+
 class Crossword {
 	private:
-		std::set<Word*, horizontal_cmp> h_words;
-		std::set<Word*, vertical_cmp> v_words;
-		std::vector<Word*> words;
+		std::shared_ptr<WordStore> store;
 		RectArea area;
 
-		bool does_collide(const Word &w) const;
-		std::optional<char> letter_at(pos_t pos) const;
-		std::optional<const Word *> closest_word(const pos_t &pos, orientation_t ori) const;
-		void delete_words();
+		// An insertion made while a checkpoint is open. A stored word is
+		// undone from its handle in the layer it went to, restoring the
+		// cells its letters filled or overwrote: the entries of
+		// journal_cells from those of the previous change up to cells_end.
+		struct Change {
+			const WordStore* layer;
+			bool stored;
+			WordArena::handle_t handle;
+			pos_t start;
+			orientation_t orientation;
+			// Extent of unstored words of the layer before the insertion.
+			RectArea unstored;
+			size_t cells_end;
+			// The roots the word put under others, from the entries of
+			// journal_roots of the previous change up to roots_end, and the
+			// splits of the layer then.
+			size_t roots_end;
+			size_t splits;
+		};
+		struct Checkpoint {
+			size_t changes;
+			size_t cells;
+			RectArea area;
+			bool checked;
+			size_t erasures;
+		};
+		std::vector<Change> journal;
+		std::vector<std::pair<pos_t, char>> journal_cells;
+		std::vector<const Word*> journal_roots;
+		std::vector<Checkpoint> checkpoints;
+		// Number of words erased so far, telling a rollback whether any
+		// were erased since its checkpoint.
+		size_t erasures = 0;
+
+		// The last rendering of the whole crossword by operator<<, laid out
+		// as by render_window, with the rows changed since marked dirty.
+		// It is rendered again whole if the columns of the area or the
+		// background change, and only the dirty and new rows otherwise.
+		// The lock keeps other threads rendering the same crossword at
+		// once off the cache. A frozen crossword is never changed again,
+		// and its cache is read as it is, without the lock.
+		struct RenderCache {
+			std::string text;
+			std::vector<char> dirty;
+			RectArea area = DEFAULT_EMPTY_RECT_AREA;
+			char background = '\0';
+		};
+		mutable RenderCache render_cache;
+		mutable std::mutex render_lock;
+		size_t render_cache_limit = DEFAULT_RENDER_CACHE_LIMIT;
+		bool render_frozen = false;
+
+#ifdef CROSSWORDS_STATS
+		enum counter_t {
+			LETTER_LOOKUPS, WORD_LOOKUPS, COLLISION_CHECKS, COLLISIONS,
+			WORDS_INSERTED, WORDS_REJECTED, BYTES_ALLOCATED, INSERT_TIME,
+			MERGE_TIME, RENDER_TIME, COUNTERS
+		};
+
+		// Atomic, as the collision checks of a merge run on several threads.
+		// Copies of a crossword start counting from zero.
+		mutable std::array<std::atomic<uint64_t>, COUNTERS> counters{};
+
+		inline void count(counter_t counter, uint64_t n = 1) const {
+			counters[counter].fetch_add(n, std::memory_order_relaxed);
+		}
+
+		// Adds the time it lives and the memory taken by word stores on its
+		// thread meanwhile to the counters of a crossword.
+		class StatsScope {
+			public:
+				StatsScope(const Crossword& crossword, counter_t time);
+				~StatsScope();
+			private:
+				const Crossword& crossword;
+				const counter_t time;
+				const std::chrono::steady_clock::time_point start;
+				const uint64_t bytes;
+		};
+#endif
+
+		Crossword();
+
+		using LayerCursors = std::array<CellIndex::Cursor, WordStore::MAX_DEPTH>;
+
+		// State carried from one insertion to the next within a batch: the
+		// last tiles visited and the last set positions, which are the right
+		// hints whenever words arrive in index order.
+		struct InsertCursor {
+			LayerCursors cells;
+			std::optional<WordStore::h_set_t::iterator> last_h;
+			std::optional<WordStore::v_set_t::iterator> last_v;
+		};
+
+		void make_writable();
+		void flatten();
+		// Merges the top layers into one, or flattens all of them.
+		void compact();
+		// Sets the area from the edges kept by the layers.
+		void update_area();
+		// Drops a word from the index of the top layer and its edge counts,
+		// or counts a word of a parent layer off them.
+		void unindex(Word* w);
+		// Empties a cell of the top layer over the letters of parent layers.
+		void clear_cell(pos_t pos, CellIndex::Cursor& cursor);
+		void undo(const Change& change, size_t cells_begin, size_t roots_begin);
+		bool does_collide(const Word &w, LayerCursors &cursors) const;
+		bool has_collision(const Word &w, LayerCursors &cursors) const;
+		bool lines_collide(const Word &w, LayerCursors &cursors) const;
+		// Bytes taken by the rendering of window, and the rendering itself.
+		static size_t rendered_size(const RectArea& window);
+		void render_window(const RectArea& window, char* out) const;
+		// The rows of the rendering of window between its borders.
+		void render_rows(const RectArea& window, char* out) const;
+		// The same drawn from the words in window, laid out blank.
+		void render_words(const RectArea& window, char* out) const;
+		// Brings the render cache up to date, unless the rendering would
+		// take more than the limit. Returns whether it did.
+		bool update_render_cache() const;
+		void mark_rows(cord_t top, cord_t bottom);
+		// A frozen copy, with the render cache brought up to date here
+		// rather than by the threads printing the copy.
+		std::unique_ptr<const Crossword> frozen_copy() const;
+		bool overlaps_parallel(const Word &w) const;
+		bool is_isolated(const Word &w, LayerCursors &cursors) const;
+		std::optional<char> letter_at(pos_t pos, LayerCursors &cursors) const;
+		bool insert_word(const Word &w, bool check_collisions, InsertCursor &cursor);
+		// For crosswords made of parts checked together, as the shards of a
+		// ShardedCrossword are: stores w, already checked against every
+		// part, leaving the crossword checked.
+		void adopt_word(const Word& w, InsertCursor& cursor);
+		// Adopts the words of part starting within starts, and the extent
+		// of the words merged into the stored ones of part.
+		void adopt_words(const Crossword& part, const RectArea& starts,
+			InsertCursor& cursor);
+		void visit_words_in(const RectArea& rect,
+			void (*visit)(const void* context, const Word& w),
+			const void* context) const;
+
+		template <typename Read, typename Unread>
+		ImportResult import_chunks(Read&& read, Unread&& unread);
+		bool import_line(std::string_view line, InsertCursor& cursor,
+			ImportResult& result);
+
+		template <std::input_iterator It, std::sentinel_for<It> S>
+		std::vector<size_t> insert_each(It first, S last) {
+			CROSSWORDS_STAT(StatsScope scope(*this, INSERT_TIME));
+			std::vector<size_t> rejected;
+			make_writable();
+			InsertCursor cursor;
+			size_t i = 0;
+			for (; first != last; ++first, ++i) {
+				if (!insert_word(*first, true, cursor))
+					rejected.push_back(i);
+			}
+			CROSSWORDS_STAT(count(WORDS_REJECTED, rejected.size()));
+			CROSSWORDS_STAT(count(WORDS_INSERTED, i - rejected.size()));
+			return rejected;
+		}
 
 	public:
 		Crossword(Word const& first, std::initializer_list<Word> other);
 		Crossword(const Crossword& other);
-		Crossword(Crossword&& other);
-		~Crossword();
+		// Leaves other empty, without allocating.
+		Crossword(Crossword&& other) noexcept;
 		inline dim_t size() const {
 			return area.size();
 		}
 		inline dim_t word_count() const {
-			return {h_words.size(), v_words.size()};
+			return {store->base_count.first + store->h_words.size()
+					- store->tombstones.first,
+				store->base_count.second + store->v_words.size()
+					- store->tombstones.second};
 		}
 		bool insert_word(Word const& w, bool check_collisions = true);
+
+		// Removes the word starting at start with the given orientation, or
+		// the word w points to as returned by words_in, and shrinks the area
+		// to what is left. Letters of crossing words stay. A word of a layer
+		// shared with a copy is erased in a layer of this crossword's own.
+		// Returns whether there was such a word.
+		bool erase_word(pos_t start, orientation_t orientation);
+		bool erase_word(const Word* w);
+
+		using checkpoint_t = size_t;
+		// Starts recording insertions. rollback undoes the ones made since
+		// the checkpoint, at a cost in the number of changes only, and
+		// commit keeps them. Both close the checkpoint along with the ones
+		// opened after it; closed checkpoints are ignored. Checkpoints nest:
+		// insertions committed within an open checkpoint are still undone
+		// by its rollback. Erasures are not recorded: words erased since
+		// the checkpoint stay erased after a rollback, and the size is
+		// worked out from the words left.
+		checkpoint_t checkpoint();
+		void rollback(checkpoint_t token);
+		void commit(checkpoint_t token);
+
+		// Counters of the work done so far, all zero unless the build
+		// defines CROSSWORDS_STATS.
+		CrosswordStats stats() const;
+		void reset_stats();
+
+		// Words sharing at least one cell with rect, including the ones that
+		// start outside of it. The pointers stay valid until the crossword
+		// is next modified. The visitor form calls f with each of them and
+		// allocates nothing.
+		std::vector<const Word*> words_in(const RectArea& rect) const;
+		template <typename F>
+		void for_each_word_in(const RectArea& rect, F&& f) const {
+			using visitor_t = std::remove_reference_t<F>;
+			visit_words_in(rect, [](const void* context, const Word& w) {
+				(*static_cast<visitor_t*>(const_cast<void*>(context)))(w);
+			}, std::addressof(f));
+		}
+
+		// Letters of the cells of a slot, with DEFAULT_CHAR for the empty
+		// ones: the pattern the words of a Dictionary placed there must match.
+		std::string pattern_at(pos_t start, orientation_t orientation,
+			size_t length) const;
+
+		// Crossings of words of other orientations sharing a cell, recorded
+		// as words are stored, so that these take time in the degree of a
+		// word alone rather than a scan of the crossword. Words are the
+		// pointers returned by words_in.
+		using Crossing = WordStore::Crossing;
+		std::vector<Crossing> crossings_of(const Word* w) const;
+		template <typename F>
+		void for_each_crossing(const Word* w, F&& f) const {
+			store->for_each_crossing(w, std::forward<F>(f));
+		}
+		size_t degree(const Word* w) const;
+		inline size_t crossing_count() const {
+			return store->crossing_count;
+		}
+		// Words crossed by d others, for each d from 0 to the largest degree.
+		std::vector<size_t> degree_counts() const;
+		// Components of the words joined by crossings. Erasing a crossed word
+		// takes the rest of its component apart again, at a cost in the size
+		// of the component.
+		inline size_t component_count() const {
+			return store->components;
+		}
+		size_t component_size(const Word* w) const;
+		bool connected(const Word* a, const Word* b) const;
+
+		// Inserts the words in order, skipping the colliding ones, and returns
+		// the indices of the skipped words. Storage for the whole batch is
+		// set aside up front when its size is known.
+		template <std::input_iterator It, std::sentinel_for<It> S>
+		std::vector<size_t> insert_words(It first, S last) {
+			if constexpr (std::sized_sentinel_for<S, It>) {
+				make_writable();
+				store->reserve(last - first);
+			}
+			return insert_each(first, last);
+		}
+		template <std::ranges::input_range R>
+		std::vector<size_t> insert_words(R&& words) {
+			if constexpr (std::ranges::sized_range<R>) {
+				make_writable();
+				store->reserve(std::ranges::size(words));
+			}
+			return insert_each(std::ranges::begin(words), std::ranges::end(words));
+		}
+		// Inserts words given by lines of the form "x y H|V WORD", where the
+		// word runs to the end of the line. Blank lines are skipped. The input
+		// is read in chunks, and the import stops at the first malformed line.
+		// A stream is read to its end, leaving eofbit and failbit set, or up
+		// to the malformed line, leaving failbit set. The chunk read past
+		// that line is put back if the stream can seek, and is consumed
+		// otherwise. Errors reading the stream, thrown or not, end up in the
+		// result.
+		ImportResult import_words(std::istream& is);
+		ImportResult import_words(std::string_view text);
+		ImportResult import_file(const std::string& path);
 		Crossword& operator=(const Crossword&);
-		Crossword& operator=(Crossword&&);
+		Crossword& operator=(Crossword&&) noexcept;
 		Crossword operator+(const Crossword& b) const;
 		Crossword& operator+=(const Crossword& b);
+
+		// Same as operator+=, but the words of b are checked against this
+		// crossword on the given number of threads before they are merged
+		// in order.
+		Crossword& merge(const Crossword& b, size_t threads);
+		// Renders the cells of window the way operator<< renders the whole
+		// crossword, border included. With clip, the window is cut down to
+		// the area first; otherwise cells off the board are background.
+		// Letters are read from the cells, so the time taken depends on the
+		// size of the window alone, unless words were inserted unchecked:
+		// then they are drawn from the words in the window.
+		void render(std::ostream& os, RectArea window, bool clip = true) const;
+		// The same into buffer, if the rendering fits in size bytes. Returns
+		// the size of the rendering either way.
+		size_t render(RectArea window, char* buffer, size_t size,
+			bool clip = true) const;
+		// Renders the whole crossword. The rendering is cached, so that the
+		// next one renders again only the rows changed in between.
 		friend std::ostream &operator<<(std::ostream &os, const Crossword &crossword);
+		static constexpr size_t DEFAULT_RENDER_CACHE_LIMIT = 64 << 20;
+		// Bytes the render cache may take. Larger crosswords are rendered
+		// without it, as are ones with words inserted unchecked, and 0 turns
+		// it off.
+		void set_render_cache_limit(size_t bytes);
+
+		// Writes the crossword in the binary format read by CrosswordView.
+		void save(std::ostream& os) const;
+		// Reads a crossword written by save, inserting its words again. Words
+		// of a crossword saved as checked are checked for collisions once
+		// more. Returns nothing if the data is malformed, a word collides or
+		// the words do not span the saved area.
+		static std::optional<Crossword> load(std::istream& is);
+
+		friend class CrosswordView;
+		friend class CrosswordFiller;
+		friend class ShardedCrossword;
+		friend class ConcurrentCrossword;
+};
+
+// Read-only crossword mapped straight from a file written by
+// Crossword::save. Only the header is checked when mapping and the words
+// are read in place, so a view of any size opens in constant time. The
+// size and the checked flag in the header are trusted until to_crossword.
+class CrosswordView {
+	private:
+		struct Header {
+			char magic[8];
+			uint32_t version;
+			uint32_t byte_order;
+			uint64_t flags;
+			uint64_t area[4];
+			// Extent of words taken for stored ones, which widen the area
+			// without records of their own.
+			uint64_t unstored[4];
+			uint64_t h_count;
+			uint64_t v_count;
+		};
+		// The header is followed by the horizontal words in the order of
+		// horizontal_cmp, the vertical ones in the order of vertical_cmp,
+		// the uint64_t indices of all of them in the order they were
+		// inserted in, and their letters, up to the end of the file.
+		struct Record {
+			uint64_t x;
+			uint64_t y;
+			uint64_t letters;
+			// The same as Word::layout.
+			uint64_t layout;
+		};
+
+		static constexpr char MAGIC[8] = {'C', 'R', 'O', 'S', 'S', 'W', 'R', 'D'};
+		static constexpr uint32_t VERSION = 2;
+		static constexpr uint32_t ORDER_MARK = 0x01020304;
+		static constexpr uint64_t CHECKED = 1;
+
+		void* data;
+		size_t bytes;
+		const Header* header;
+		const Record* h_words;
+		const Record* v_words;
+		std::string_view letters;
+
+		CrosswordView(void* mapped, size_t mapped_bytes);
+		// A view of an image that is not mapped, and is not unmapped.
+		static CrosswordView borrow(const void* image, size_t image_bytes) {
+			CrosswordView view(const_cast<void*>(image), image_bytes);
+			view.data = nullptr;
+			return view;
+		}
+		static bool valid_header(const Header& header, size_t words);
+		static constexpr RectArea rect_of(const uint64_t (&corners)[4]) {
+			return RectArea({corners[0], corners[1]}, {corners[2], corners[3]});
+		}
+		static constexpr void set_rect(uint64_t (&corners)[4],
+				const RectArea& rect) {
+			corners[0] = rect.get_left_top().first;
+			corners[1] = rect.get_left_top().second;
+			corners[2] = rect.get_right_bottom().first;
+			corners[3] = rect.get_right_bottom().second;
+		}
+		static std::string_view letters_of(const Record& record,
+			std::string_view letters);
+
+		friend class Crossword;
+		template <const auto& words>
+		friend class StaticCrossword;
+	public:
+		// Maps the file at path. Returns nothing if it cannot be mapped or
+		// its header does not describe a crossword of this version.
+		static std::optional<CrosswordView> map(const std::string& path);
+		CrosswordView(CrosswordView&& other);
+		CrosswordView(const CrosswordView&) = delete;
+		CrosswordView& operator=(const CrosswordView&) = delete;
+		~CrosswordView();
+		// The size recorded in the header, which is not checked against
+		// the words.
+		dim_t size() const;
+		inline dim_t word_count() const {
+			return {header->h_count, header->v_count};
+		}
+		std::optional<char> letter_at(pos_t pos) const;
+		// A writable copy of the crossword, sized by its words. Words of a
+		// crossword saved as checked are checked again in the order they
+		// were inserted in, and one that collides is kept but leaves the
+		// copy unchecked.
+		Crossword to_crossword() const;
+};
+
+// A word of a board laid out at compile time. Its letters are upper-cased
+// like those of a Word, and no letters stand for DEFAULT_WORD.
+struct TemplateWord {
+	pos_t start;
+	orientation_t orientation;
+	std::string_view letters;
+
+	constexpr pos_t get_start_position() const {
+		return start;
+	}
+	constexpr orientation_t get_orientation() const {
+		return orientation;
+	}
+	constexpr size_t length() const {
+		return letters.empty() ? 1 : letters.size();
+	}
+	constexpr char at(size_t pos) const {
+		if (pos >= letters.size())
+			return DEFAULT_CHAR;
+		char c = letters[pos];
+		return c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c;
+	}
+	constexpr pos_t pos_of_letter(size_t offset) const {
+		return letter_position(start, orientation, offset);
+	}
+	constexpr pos_t get_end_position() const {
+		return pos_of_letter(length() - 1);
+	}
+	constexpr RectArea rect_area() const {
+		return RectArea(start, get_end_position());
+	}
+};
+
+// Index of the first word that collides with the ones before it when the
+// words are inserted in order, or words.size() if none does.
+constexpr size_t first_colliding(std::span<const TemplateWord> words) {
+	for (size_t i = 0; i < words.size(); i++) {
+		const TemplateWord& w = words[i];
+		auto letter_at = [&words, i](pos_t pos) -> std::optional<char> {
+			for (size_t j = 0; j < i; j++) {
+				const TemplateWord& other = words[j];
+				pos_t start = other.get_start_position();
+				pos_t end = other.get_end_position();
+				if (start <= pos && pos <= end && (other.orientation == H
+						? pos.second == start.second : pos.first == start.first))
+					return other.at(other.orientation == H
+						? pos.first - start.first : pos.second - start.second);
+			}
+			return {};
+		};
+		if (collides_with_letters(w, letter_at))
+			return i;
+		// Words of the same orientation may not run over each other, other
+		// than a word repeated.
+		for (size_t j = 0; j < i; j++) {
+			const TemplateWord& other = words[j];
+			if (other.orientation != w.orientation
+					|| (other.start == w.start && other.length() == w.length()))
+				continue;
+			if (!(other.rect_area() * w.rect_area()).empty())
+				return i;
+		}
+	}
+	return words.size();
+}
+
+// A board built at compile time from an array of TemplateWord with static
+// storage. The words are checked as by insert_word and laid out as written
+// by Crossword::save, so a template that collides fails to compile, and the
+// board is read in place from read-only data with no work at startup.
+template <const auto& words>
+class StaticCrossword {
+	private:
+		using Header = CrosswordView::Header;
+		using Record = CrosswordView::Record;
+
+		static_assert(std::size(words) > 0, "a template needs words");
+		static_assert(first_colliding(words) == std::size(words),
+			"a word of the template collides with the ones before it");
+
+		// Whether the word with index i repeats one before it, which takes
+		// no storage of its own.
+		static constexpr bool is_repeat(size_t i) {
+			for (size_t j = 0; j < i; j++) {
+				if (words[j].start == words[i].start
+						&& words[j].orientation == words[i].orientation)
+					return true;
+			}
+			return false;
+		}
+		static constexpr size_t count_stored(orientation_t orientation) {
+			size_t count = 0;
+			for (size_t i = 0; i < std::size(words); i++)
+				count += !is_repeat(i) && words[i].orientation == orientation;
+			return count;
+		}
+		static constexpr size_t count_letters() {
+			size_t count = 0;
+			for (size_t i = 0; i < std::size(words); i++)
+				count += is_repeat(i) ? 0 : words[i].length();
+			return count;
+		}
+
+		static constexpr size_t H_COUNT = count_stored(H);
+		static constexpr size_t COUNT = H_COUNT + count_stored(V);
+		static constexpr size_t LETTERS = count_letters();
+
+		struct Image {
+			Header header;
+			Record records[COUNT];
+			uint64_t order[COUNT];
+			char letters[LETTERS];
+		};
+		static_assert(offsetof(Image, letters)
+			== sizeof(Header) + COUNT * (sizeof(Record) + sizeof(uint64_t)));
+
+		static constexpr Image build() {
+			Image image{};
+			Header& header = image.header;
+			std::copy_n(CrosswordView::MAGIC, sizeof(header.magic), header.magic);
+			header.version = CrosswordView::VERSION;
+			header.byte_order = CrosswordView::ORDER_MARK;
+			header.flags = CrosswordView::CHECKED;
+			header.h_count = H_COUNT;
+			header.v_count = COUNT - H_COUNT;
+
+			// Horizontal words in the order of horizontal_cmp, then the
+			// vertical ones in the order of vertical_cmp.
+			std::array<size_t, COUNT> sorted{};
+			size_t stored = 0;
+			for (size_t i = 0; i < std::size(words); i++) {
+				if (!is_repeat(i))
+					sorted[stored++] = i;
+			}
+			std::sort(sorted.begin(), sorted.end(), [](size_t a, size_t b) {
+				const TemplateWord& w1 = words[a];
+				const TemplateWord& w2 = words[b];
+				if (w1.orientation != w2.orientation)
+					return w1.orientation == H;
+				if (w1.orientation == H)
+					return std::pair(w1.start.second, w1.start.first)
+						< std::pair(w2.start.second, w2.start.first);
+				return w1.start < w2.start;
+			});
+
+			RectArea area = DEFAULT_EMPTY_RECT_AREA;
+			size_t letters = 0;
+			for (size_t r = 0; r < COUNT; r++) {
+				const TemplateWord& w = words[sorted[r]];
+				image.records[r] = {w.start.first, w.start.second, letters,
+					w.length() << 1 | w.orientation};
+				for (size_t i = 0; i < w.length(); i++)
+					image.letters[letters++] = w.at(i);
+				area.embrace(w.get_start_position());
+				area.embrace(w.get_end_position());
+			}
+			for (size_t i = 0, inserted = 0; i < std::size(words); i++) {
+				if (!is_repeat(i))
+					image.order[inserted++] =
+						std::find(sorted.begin(), sorted.end(), i) - sorted.begin();
+			}
+			// Repeats are the same words again, as any other collides, so
+			// none widens the area.
+			CrosswordView::set_rect(header.area, area);
+			CrosswordView::set_rect(header.unstored, DEFAULT_EMPTY_RECT_AREA);
+			return image;
+		}
+
+		static constexpr Image IMAGE = build();
+	public:
+		static constexpr dim_t size() {
+			return CrosswordView::rect_of(IMAGE.header.area).size();
+		}
+		static constexpr dim_t word_count() {
+			return {H_COUNT, COUNT - H_COUNT};
+		}
+		// The board, viewed where it lies in the program's data.
+		static CrosswordView view() {
+			return CrosswordView::borrow(&IMAGE, offsetof(Image, letters) + LETTERS);
+		}
 };
 
 #endif
\ No newline at end of file
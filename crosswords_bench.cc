@@ -0,0 +1,661 @@
+/*
+ * Benchmarks of the crossword hot paths. Results are written to the
+ * standard output as JSON. The largest random board is given by the first
+ * argument, 1M words by default.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "crosswords.h"
+#include "crosswords_concurrent.h"
+#include "crosswords_sharded.h"
+#include "crosswords_dictionary.h"
+#include "crosswords_fill.h"
+
+namespace {
+    using orientation_t::H;
+    using orientation_t::V;
+
+    size_t allocations = 0;
+    size_t allocated_bytes = 0;
+
+    // Words of a lattice layout: horizontal words in every other row,
+    // long enough to spill out of the small string buffer.
+    Word lattice_word(size_t i) {
+        std::string content = "benchmarkword";
+        content += static_cast<char>('a' + i % 26);
+        content += static_cast<char>('a' + i / 26 % 26);
+        content += static_cast<char>('a' + i / 676 % 26);
+        return Word((i % 100) * 20, (i / 100) * 2, H, std::move(content));
+    }
+
+    struct Result {
+        std::string name;
+        std::string board;
+        size_t words;
+        size_t allocations;
+        size_t bytes;
+        double ms;
+        // Figures particular to the benchmark.
+        std::vector<std::pair<const char *, double>> metrics;
+    };
+
+    // Kept in a deque, so that the result returned by measure stays valid.
+    std::deque<Result> results;
+
+    template <typename F>
+    Result &measure(const std::string &name, size_t words, F &&f) {
+        size_t allocations_before = allocations;
+        size_t bytes_before = allocated_bytes;
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::milli> ms = end - start;
+        return results.emplace_back(Result{
+            name, "lattice", words, allocations - allocations_before,
+            allocated_bytes - bytes_before, ms.count(), {}});
+    }
+
+    void print_json(std::ostream &os) {
+        os.precision(15);
+        os << "{\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result &r = results[i];
+            os << (i > 0 ? ",\n" : "\n") << "    {\"name\": \"" << r.name
+               << "\", \"board\": \"" << r.board << "\", \"words\": " << r.words
+               << ", \"time_ms\": " << r.ms
+               << ", \"allocations\": " << r.allocations
+               << ", \"bytes\": " << r.bytes
+                  << ", \"bytes_per_word\": "
+               << r.bytes / std::max<size_t>(r.words, 1);
+            for (const auto &[metric, value] : r.metrics)
+                os << ", \"" << metric << "\": " << value;
+            os << '}';
+        }
+        os << "\n  ]\n}\n";
+    }
+
+    std::vector<Word> lattice(size_t words) {
+        std::vector<Word> input;
+        input.reserve(words);
+        for (size_t i = 0; i < words; i++)
+            input.push_back(lattice_word(i));
+        return input;
+    }
+
+    // Seeded random placements of words of 3 to 10 letters out of a small
+    // alphabet, so that crossing letters often match. A dense board packs
+    // them so that most of them collide, a sparse one leaves room for
+    // nearly all of them.
+    std::vector<Word> random_words(size_t words, bool dense, uint64_t seed) {
+        std::mt19937_64 random(seed);
+        cord_t side = std::sqrt(words * (dense ? 12.0 : 100.0)) + 10;
+        std::uniform_int_distribution<cord_t> coordinate(0, side);
+        std::uniform_int_distribution<size_t> length(3, 10);
+        std::uniform_int_distribution<int> letter(0, 5);
+        std::vector<Word> input;
+        input.reserve(words);
+        for (size_t i = 0; i < words; i++) {
+            std::string content(length(random), ' ');
+            for (char &c : content)
+                c = static_cast<char>('A' + letter(random));
+            cord_t x = coordinate(random);
+            cord_t y = coordinate(random);
+            input.emplace_back(x, y, random() % 2 ? H : V, std::move(content));
+        }
+        return input;
+    }
+
+    void random_bench(size_t words, bool dense) {
+        const char *board = dense ? "dense" : "sparse";
+        std::vector<Word> input = random_words(words, dense, words);
+
+        Crossword cr(input[0], {});
+        measure("insert_word", words, [&]() {
+            for (size_t i = 1; i < words; i++)
+                cr.insert_word(input[i]);
+        }).board = board;
+        std::vector<uint32_t> accepted, rejected;
+        for (size_t i = 1; i < words; i++)
+            (cr.insert_word(input[i]) ? accepted : rejected).push_back(i);
+        results.back().metrics.emplace_back("accepted", accepted.size());
+
+        // The same board again out of the accepted words alone, replacing
+        // the first one: the largest boards only fit in memory one at
+        // a time.
+        cr = Crossword(input[0], {});
+        measure("insert_accepted", accepted.size(), [&]() {
+            for (uint32_t i : accepted)
+                cr.insert_word(input[i]);
+        }).board = board;
+        // A rejected word does nothing but the collision check.
+        measure("does_collide", rejected.size(), [&]() {
+            for (uint32_t i : rejected)
+                cr.insert_word(input[i]);
+        }).board = board;
+        input = std::vector<Word>();
+
+        // Long words agreeing with the letters already in their slots, as
+        // a filler tries them: most are checked over their whole length.
+        {
+            std::mt19937_64 random(words + 4);
+            std::uniform_int_distribution<cord_t> coordinate(0,
+                                                             cr.size().first);
+            std::uniform_int_distribution<size_t> length(12, 32);
+            std::vector<Word> trials;
+            for (size_t i = 0; i < 100000; i++) {
+                pos_t start(coordinate(random), coordinate(random));
+                orientation_t orientation = i % 2 ? H : V;
+                std::string letters = cr.pattern_at(start, orientation,
+                                                    length(random));
+                for (char &c : letters)
+                    c = c == DEFAULT_CHAR ? 'A' + random() % 6 : c;
+                trials.emplace_back(start.first, start.second, orientation,
+                                    std::move(letters));
+            }
+            size_t fit = 0;
+            measure("does_collide_long", trials.size(), [&]() {
+                for (const Word &w : trials) {
+                    Crossword::checkpoint_t token = cr.checkpoint();
+                    fit += cr.insert_word(w);
+                    cr.rollback(token);
+                }
+            }).board = board;
+            results.back().metrics.emplace_back("accepted", fit);
+        }
+
+        // Slots of 8 cells, read a letter at a time.
+        std::mt19937_64 random(words + 1);
+        std::uniform_int_distribution<cord_t> coordinate(0, cr.size().first);
+        size_t slots = 100000;
+        std::vector<pos_t> starts;
+        for (size_t i = 0; i < slots; i++) {
+            cord_t x = coordinate(random);
+            starts.emplace_back(x, coordinate(random));
+        }
+        size_t letters = 0;
+        measure("letter_at", slots * 8, [&]() {
+            for (size_t i = 0; i < slots; i++) {
+                std::string pattern =
+                    cr.pattern_at(starts[i], i % 2 ? H : V, 8);
+                letters += 8 - std::count(pattern.begin(), pattern.end(),
+                                          DEFAULT_CHAR);
+            }
+        }).board = board;
+        results.back().metrics.emplace_back("letters_found", letters);
+
+        std::optional<Crossword> copy;
+        measure("copy", words, [&]() { copy.emplace(cr); }).board = board;
+        measure("move", words, [&]() {
+            Crossword moved(std::move(*copy));
+        }).board = board;
+
+        // A board a tenth of the size laid over this one.
+        std::vector<Word> more = random_words(words / 10, dense, words + 2);
+        Crossword other(more[0], {});
+        other.insert_words(more);
+        more = std::vector<Word>();
+        measure("operator+=", words / 10, [&]() {
+            Crossword sum(cr);
+            sum += other;
+        }).board = board;
+
+        // Trial placements, each undone right after.
+        std::vector<Word> trials = random_words(words / 10, dense, words + 3);
+        size_t tried = 0;
+        measure("checkpoint_rollback", trials.size(), [&]() {
+            for (const Word &w : trials) {
+                Crossword::checkpoint_t token = cr.checkpoint();
+                tried += cr.insert_word(w);
+                cr.rollback(token);
+            }
+        }).board = board;
+        results.back().metrics.emplace_back("accepted", tried);
+        trials = std::vector<Word>();
+
+        // Rendering writes every cell of the area.
+        if (cr.size().first * cr.size().second <= 64 << 20) {
+            measure("render", words, [&]() {
+                std::ostringstream out;
+                out << cr;
+            }).board = board;
+        }
+        // What a UI shows: 80x40 windows anywhere on the board.
+        std::string window(20000, '\0');
+        size_t windows = 10000;
+        measure("render_window", windows, [&]() {
+            for (size_t i = 0; i < windows; i++) {
+                cord_t x = coordinate(random), y = coordinate(random);
+                cr.render(RectArea({x, y}, {x + 79, y + 39}), window.data(),
+                          window.size());
+            }
+        }).board = board;
+
+        // The words crossing each word as recorded, and as found again by
+        // looking up the words at each of its cells.
+        std::vector<const Word *> stored = cr.words_in(
+            RectArea({0, 0}, {MAX_COORDINATE, MAX_COORDINATE}));
+        size_t crossed = 0, joined = 0;
+        measure("crossings", stored.size(), [&]() {
+            for (const Word *w : stored) {
+                cr.for_each_crossing(
+                    w, [&crossed](const Crossword::Crossing &) { crossed++; });
+                joined += cr.connected(w, stored[0]);
+            }
+        }).board = board;
+        results.back().metrics.emplace_back("crossings", crossed / 2);
+        results.back().metrics.emplace_back("components",
+                                            cr.component_count());
+        results.back().metrics.emplace_back("connected_to_first", joined);
+        size_t found = 0;
+        measure("crossings_rescan", stored.size(), [&]() {
+            for (const Word *w : stored) {
+                for (size_t i = 0; i < w->length(); i++) {
+                    pos_t cell = w->pos_of_letter(i);
+                    cr.for_each_word_in(RectArea(cell, cell),
+                                        [&found, w](const Word &c) {
+                        found += c.get_orientation() != w->get_orientation();
+                    });
+                }
+            }
+        }).board = board;
+        results.back().metrics.emplace_back("crossings", found / 2);
+    }
+
+    void storage_bench(size_t words) {
+        std::vector<Word> input = lattice(words);
+
+        Crossword cr(input[0], {});
+        measure("insert_word", words, [&]() {
+            for (size_t i = 1; i < words; i++)
+                cr.insert_word(input[i]);
+        });
+        // Words already in place are only looked up.
+        measure("reinsert", words, [&]() {
+            for (size_t i = 1; i < words; i++)
+                cr.insert_word(input[i]);
+        });
+        measure("copy", words, [&]() { Crossword copy(cr); });
+        Crossword other(Word(0, (words / 100 + 2) * 2, V, "apart"), {});
+        measure("operator+", words, [&]() { Crossword sum = other + cr; });
+        measure("render", words, [&]() {
+            std::ostringstream out;
+            out << cr;
+        });
+        // The board printed again after each of a few small edits, with and
+        // without the render cache.
+        for (bool cached : {true, false}) {
+            Crossword edited = cr;
+            edited.set_render_cache_limit(
+                cached ? Crossword::DEFAULT_RENDER_CACHE_LIMIT : 0);
+            std::ostringstream out;
+            out << edited;
+            measure(cached ? "render_after_edit" : "render_after_edit_uncached",
+                    words, [&]() {
+                        for (size_t i = 0; i < 20; i++) {
+                            edited.insert_word(
+                                Word(i * 20 + 18, 2 * i, V, "edit"));
+                            out.str("");
+                            out << edited;
+                        }
+                    });
+        }
+        // An 80x40 viewport moved down the lattice.
+        size_t found = 0;
+        measure("words_in", words, [&]() {
+            for (cord_t y = 0; y < (words / 100) * 2; y += 40)
+                cr.for_each_word_in(RectArea({510, y}, {589, y + 39}),
+                                    [&found](const Word &) { found++; });
+        });
+    }
+
+    // Every tenth word is shifted onto its predecessor and gets rejected.
+    void bulk_bench(size_t words) {
+        std::vector<Word> input = lattice(words);
+        for (size_t i = 10; i < words; i += 10)
+            input[i] = Word((i % 100) * 20 - 1, (i / 100) * 2, V, "rejected");
+
+        Crossword looped(input[0], {});
+        measure("insert_word_loop", words, [&]() {
+            for (size_t i = 1; i < words; i++)
+                looped.insert_word(input[i]);
+        });
+        Crossword bulk(input[0], {});
+        measure("insert_words", words, [&]() {
+            bulk.insert_words(input.begin() + 1, input.end());
+        });
+    }
+
+    // Variants forked off a base puzzle, each adding a handful of words.
+    void fork_bench(size_t words, size_t variants) {
+        std::vector<Word> input = lattice(words);
+        Crossword base(input[0], {});
+        base.insert_words(input);
+
+        std::vector<Crossword> forks;
+        forks.reserve(variants);
+        measure("fork_variants", words, [&]() {
+            for (size_t i = 0; i < variants; i++) {
+                forks.push_back(base);
+                for (size_t j = 0; j < 5; j++)
+                    forks.back().insert_word(
+                        Word(2000 + 2 * j, i, V, "variant"));
+            }
+        });
+
+        // Each version a copy of the last one, extended: the layers stack up
+        // over the base, and only the small ones on top are merged.
+        Crossword chain = base;
+        std::vector<Crossword> versions;
+        versions.reserve(variants);
+        measure("fork_chain", words, [&]() {
+            for (size_t i = 0; i < variants; i++) {
+                versions.push_back(chain);
+                for (size_t j = 0; j < 5; j++)
+                    chain.insert_word(Word(2000 + 2 * j, 10 * i, V, "chain"));
+            }
+        });
+    }
+
+    // Vertical words filling the gaps between the rows of a lattice, so that
+    // every one of them is checked against the lattice and accepted.
+    void merge_bench(size_t words) {
+        std::vector<Word> input = lattice(words);
+        Crossword a(input[0], {});
+        a.insert_words(input);
+
+        std::vector<Word> gaps;
+        for (size_t i = 0; i < words; i++)
+            gaps.emplace_back((i % 100) * 20 + 18, (i / 100) * 20, V,
+                              "verticalwordsabc");
+        Crossword b(gaps[0], {});
+        b.insert_words(gaps);
+
+        for (size_t threads : {1, 2, 4}) {
+            std::string name = "merge_threads_" + std::to_string(threads);
+            measure(name, words, [&]() {
+                Crossword merged = a;
+                merged.merge(b, threads);
+            });
+        }
+    }
+
+    // Reader threads rendering 80x40 windows of the latest published
+    // version of a lattice, while the writer keeps extending it and
+    // publishes every hundred words.
+    void concurrent_bench(size_t words) {
+        std::vector<Word> input = lattice(words);
+        Crossword base(input[0], {});
+        base.insert_words(input);
+
+        constexpr size_t READS = 20000;
+        for (size_t threads : {1, 2, 4}) {
+            ConcurrentCrossword cc(base);
+            std::atomic<size_t> running{threads};
+            size_t published = 0;
+            std::string name = "concurrent_reads_" + std::to_string(threads);
+            measure(name, READS * threads, [&]() {
+                std::vector<std::thread> readers;
+                for (size_t t = 0; t < threads; t++) {
+                    readers.emplace_back([&cc, &running, t] {
+                        ConcurrentCrossword::Reader reader = *cc.reader();
+                        char window[4000];
+                        for (size_t i = 0; i < READS; i++) {
+                            ConcurrentCrossword::Snapshot s = *reader.read();
+                            cord_t y = (i * 7 + t * 13) % s->size().second;
+                            s->render(RectArea({500, y}, {579, y + 39}),
+                                      window, sizeof(window));
+                        }
+                        running--;
+                    });
+                }
+                for (size_t i = words; running > 0; i++) {
+                    cc.draft().insert_word(lattice_word(i));
+                    if (i % 100 == 0) {
+                        cc.publish();
+                        published++;
+                    }
+                }
+                for (std::thread &t : readers)
+                    t.join();
+            });
+            results.back().metrics.emplace_back("publications", published);
+            results.back().metrics.emplace_back(
+                "reads_per_second", READS * threads * 1000 / results.back().ms);
+        }
+    }
+
+    // The sparse random board built in shards on several threads, next to
+    // the sequential insert_word of random_bench.
+    void sharded_bench(size_t words) {
+        std::vector<Word> input = random_words(words, false, words);
+        for (size_t threads : {1, 2, 4}) {
+            ShardedCrossword sharded;
+            std::vector<size_t> rejected;
+            std::string name = "sharded_insert_threads_" +
+                               std::to_string(threads);
+            measure(name, words, [&]() {
+                rejected = sharded.insert_words(input, threads);
+            }).board = "sparse";
+            results.back().metrics.emplace_back("accepted",
+                                                words - rejected.size());
+            results.back().metrics.emplace_back("shards",
+                                                sharded.shard_count());
+        }
+    }
+
+    // Starting up from a saved board: mapped, copied into a crossword that
+    // keeps colliding words, or rebuilt rejecting them. Both of the latter
+    // check the words of a checked board again.
+    void file_bench(size_t words) {
+        std::vector<Word> input = lattice(words);
+        Crossword board(input[0], {});
+        board.insert_words(input);
+
+        const char *path = "crosswords_bench.bin";
+        measure("save", words, [&]() {
+            std::ofstream out(path, std::ios::binary);
+            board.save(out);
+        });
+        measure("map", words, [&]() {
+            std::optional<CrosswordView> view = CrosswordView::map(path);
+            if (!view || view->letter_at({20, 2}) != 'B')
+                std::abort();
+        });
+        measure("to_crossword", words, [&]() {
+            Crossword copy = CrosswordView::map(path)->to_crossword();
+        });
+        measure("load", words, [&]() {
+            std::ifstream in(path, std::ios::binary);
+            if (!Crossword::load(in))
+                std::abort();
+        });
+        std::remove(path);
+    }
+
+    // Placements given as text lines, imported in bulk or parsed line by
+    // line into words inserted one at a time.
+    void import_bench(size_t words) {
+        std::string text;
+        for (const Word &w : lattice(words)) {
+            text += std::to_string(w.get_start_position().first) + ' ' +
+                    std::to_string(w.get_start_position().second) + " H ";
+            for (size_t i = 0; i < w.length(); i++)
+                text += static_cast<char>(std::tolower(w.at(i)));
+            text += '\n';
+        }
+
+        Crossword imported(Word(0, 1, V, "x"), {});
+        measure("import_words", words, [&]() { imported.import_words(text); });
+        Crossword parsed(Word(0, 1, V, "x"), {});
+        measure("parse_lines", words, [&]() {
+            std::istringstream in(text);
+            size_t x, y;
+            char orientation;
+            std::string content;
+            while (in >> x >> y >> orientation >> content)
+                parsed.insert_word(
+                    Word(x, y, orientation == 'H' ? H : V, std::move(content)));
+        });
+    }
+
+    // A dictionary of pseudo-random words filling an empty area around
+    // a seed, searched for a fixed number of nodes.
+    void fill_bench(size_t dictionary_words) {
+        std::vector<std::string> dictionary;
+        uint32_t state = 12345;
+        for (size_t i = 0; i < dictionary_words; i++) {
+            std::string word;
+            for (size_t n = 0; n < 3 + i % 6; n++) {
+                state = state * 1103515245 + 12345;
+                word += static_cast<char>('a' + (state >> 16) % 26);
+            }
+            dictionary.push_back(std::move(word));
+        }
+        CrosswordFiller filler(dictionary);
+        Crossword start(Word(20, 20, H, std::string(dictionary[5])), {});
+
+        for (size_t threads : {1, 4}) {
+            FillLimits limits;
+            limits.threads = threads;
+            limits.time_limit = std::chrono::milliseconds(10000);
+            limits.node_limit = 5000;
+            std::string name = "fill_threads_" + std::to_string(threads);
+            Result &result = measure(name, dictionary_words, [&]() {
+                filler.fill(start, RectArea({0, 0}, {49, 49}), limits);
+            });
+            result.board = "dictionary";
+            result.metrics.emplace_back("nodes", filler.stats().nodes);
+            result.metrics.emplace_back("nodes_per_second",
+                                        filler.stats().nodes_per_second());
+            result.metrics.emplace_back("words_placed", filler.stats().words);
+        }
+    }
+
+    // Patterns of two fixed letters queried against a dictionary of
+    // pseudo-random words, through the index or with a linear scan.
+    void dictionary_bench(size_t dictionary_words, size_t queries) {
+        std::vector<std::string> words;
+        uint32_t state = 1;
+        auto next_letter = [&state]() {
+            state = state * 1103515245 + 12345;
+            return static_cast<char>('A' + (state >> 16) % 26);
+        };
+        for (size_t i = 0; i < dictionary_words; i++) {
+            std::string word;
+            for (size_t n = 0; n < 3 + i % 10; n++)
+                word += next_letter();
+            words.push_back(std::move(word));
+        }
+        std::vector<std::string> patterns;
+        for (size_t i = 0; i < queries; i++) {
+            std::string pattern(3 + i % 10, DEFAULT_CHAR);
+            pattern[i % pattern.size()] = next_letter();
+            pattern[(i + 2) % pattern.size()] = next_letter();
+            patterns.push_back(std::move(pattern));
+        }
+
+        std::optional<Dictionary> dictionary;
+        measure("dictionary_build", dictionary_words, [&]() {
+            dictionary.emplace(words);
+        }).board = "dictionary";
+        size_t found = 0;
+        measure("dictionary_count", queries, [&]() {
+            for (const std::string &pattern : patterns)
+                found += dictionary->count(pattern);
+        }).board = "dictionary";
+        measure("dictionary_matches", queries, [&]() {
+            for (const std::string &pattern : patterns)
+                dictionary->for_each_match(
+                    pattern, [&found](std::string_view) { found++; });
+        }).board = "dictionary";
+        measure("dictionary_scan", queries / 100, [&]() {
+            for (size_t q = 0; q < queries / 100; q++) {
+                const std::string &pattern = patterns[q];
+                for (const std::string &w : words) {
+                    bool match = w.size() == pattern.size();
+                    for (size_t i = 0; match && i < w.size(); i++)
+                        match = pattern[i] == DEFAULT_CHAR ||
+                                pattern[i] == w[i];
+                    found += match;
+                }
+            }
+        }).board = "dictionary";
+        if (found == 0)
+            std::abort();
+    }
+
+    // The replaced operator new and delete all go through this pair. Kept
+    // out of line, so that the compiler matches each delete with the
+    // operator new it saw rather than with the free inside.
+    [[gnu::noinline]] void *counted_alloc(size_t size, size_t align) {
+        allocations++;
+        allocated_bytes += size;
+        if (align <= alignof(std::max_align_t))
+            return std::malloc(size ? size : 1);
+        return std::aligned_alloc(align, (size + align - 1) / align * align);
+    }
+
+    [[gnu::noinline]] void counted_free(void *ptr) noexcept { std::free(ptr); }
+}   /* anonymous namespace */
+
+void *operator new(size_t size) {
+    if (void *ptr = counted_alloc(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+// Memory resources ask for their blocks with an explicit alignment.
+void *operator new(size_t size, std::align_val_t alignment) {
+    if (void *ptr = counted_alloc(size, static_cast<size_t>(alignment)))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { counted_free(ptr); }
+
+void operator delete(void *ptr, size_t) noexcept { counted_free(ptr); }
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    counted_free(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+    counted_free(ptr);
+}
+
+int main(int argc, char *argv[]) {
+    size_t max_words =
+        argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    for (size_t words = 1000; words <= max_words; words *= 10) {
+        random_bench(words, true);
+        random_bench(words, false);
+    }
+    for (size_t words : {1000, 100000})
+        storage_bench(words);
+    for (size_t words : {10000, 100000, 1000000})
+        bulk_bench(words);
+    fork_bench(100000, 1000);
+    merge_bench(100000);
+    concurrent_bench(100000);
+    sharded_bench(1000000);
+    file_bench(1000000);
+    import_bench(1000000);
+    fill_bench(10000);
+    dictionary_bench(500000, 10000);
+    print_json(std::cout);
+
+    return 0;
+}
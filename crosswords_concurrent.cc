@@ -0,0 +1,78 @@
+#include "crosswords_concurrent.h"
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+// Every access to current, epoch and the slot epochs is sequentially
+// consistent. A reader announces the epoch it read before it loads
+// current, and the writer bumps the epoch after it replaces current, so
+// a reader that loaded a replaced version announced an epoch no later
+// than the one the version was retired in, and was seen doing so when
+// the writer scans the slots.
+
+ConcurrentCrossword::Snapshot::Snapshot(std::atomic<uint64_t> *slot,
+                                        const Crossword *version)
+    : slot(slot), version(version) {}
+
+ConcurrentCrossword::Snapshot::Snapshot(Snapshot &&other)
+    : slot(std::exchange(other.slot, nullptr)), version(other.version) {}
+
+ConcurrentCrossword::Snapshot::~Snapshot() {
+    if (slot != nullptr)
+        slot->store(IDLE);
+}
+
+ConcurrentCrossword::Reader::Reader(const ConcurrentCrossword &owner,
+                                    Slot &slot)
+    : owner(&owner), slot(&slot) {}
+
+ConcurrentCrossword::Reader::Reader(Reader &&other)
+    : owner(other.owner), slot(std::exchange(other.slot, nullptr)) {}
+
+ConcurrentCrossword::Reader::~Reader() {
+    if (slot != nullptr)
+        slot->taken.store(false);
+}
+
+// Only the thread using the reader changes the epoch of its slot from IDLE.
+std::optional<ConcurrentCrossword::Snapshot>
+ConcurrentCrossword::Reader::read() {
+    if (slot->epoch.load() != IDLE)
+        return std::nullopt;
+    slot->epoch.store(owner->epoch.load());
+    return Snapshot(&slot->epoch, owner->current.load());
+}
+
+ConcurrentCrossword::ConcurrentCrossword(Crossword initial,
+                                         size_t max_readers)
+    : current(initial.frozen_copy().release()), slots(max_readers),
+      draft_(std::move(initial)) {}
+
+ConcurrentCrossword::~ConcurrentCrossword() { delete current.load(); }
+
+void ConcurrentCrossword::publish() {
+    std::unique_ptr<const Crossword> version = draft_.frozen_copy();
+    std::unique_ptr<const Crossword> replaced(
+        current.exchange(version.release()));
+    retired.push_back({epoch.fetch_add(1), std::move(replaced)});
+    reclaim();
+}
+
+void ConcurrentCrossword::reclaim() {
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for (const Slot &slot : slots) {
+        uint64_t announced = slot.epoch.load();
+        if (announced != IDLE)
+            oldest = std::min(oldest, announced);
+    }
+    std::erase_if(retired,
+                  [oldest](const Retired &r) { return r.epoch < oldest; });
+}
+
+std::optional<ConcurrentCrossword::Reader> ConcurrentCrossword::reader() {
+    for (Slot &slot : slots) {
+        if (!slot.taken.load() && !slot.taken.exchange(true))
+            return Reader(*this, slot);
+    }
+    return std::nullopt;
+}
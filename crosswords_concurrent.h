@@ -0,0 +1,111 @@
+#ifndef CROSSWORDS_CONCURRENT_H
+#define CROSSWORDS_CONCURRENT_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+#include "crosswords.h"
+
+// A crossword written by one thread and read by many. The writer changes
+// a draft of its own and publishes it when a batch is done; each
+// publication is an immutable copy of the draft, which shares its layers,
+// together with its rendering, in which the writer redraws only the rows
+// changed since. Readers take the latest version and print it without
+// locks, and versions no longer published are freed by the writer once no
+// reader can still hold them: a reader announces the epoch it starts
+// reading in, and a version is freed when every reader reading has started
+// after the version was replaced.
+class ConcurrentCrossword {
+	private:
+		static constexpr uint64_t IDLE = 0;
+
+		struct alignas(64) Slot {
+			std::atomic<uint64_t> epoch{IDLE};
+			std::atomic<bool> taken{false};
+		};
+
+		struct Retired {
+			uint64_t epoch;
+			std::unique_ptr<const Crossword> version;
+		};
+
+		alignas(64) std::atomic<const Crossword*> current;
+		std::atomic<uint64_t> epoch{1};
+		std::vector<Slot> slots;
+
+		alignas(64) Crossword draft_;
+		std::vector<Retired> retired;
+
+		// Frees the versions no reader can hold.
+		void reclaim();
+
+	public:
+		static constexpr size_t DEFAULT_MAX_READERS = 64;
+
+		// The version current when it was taken, unchanged until the
+		// snapshot goes away.
+		class Snapshot {
+			public:
+				Snapshot(Snapshot&& other);
+				Snapshot& operator=(Snapshot&&) = delete;
+				~Snapshot();
+				inline const Crossword& operator*() const {
+					return *version;
+				}
+				inline const Crossword* operator->() const {
+					return version;
+				}
+
+			private:
+				Snapshot(std::atomic<uint64_t>* slot, const Crossword* version);
+				std::atomic<uint64_t>* slot;
+				const Crossword* version;
+				friend class ConcurrentCrossword;
+		};
+
+		// The slot of a reading thread. A reader is used by one thread at
+		// a time and holds at most one snapshot at a time: read returns
+		// nothing while the last snapshot it returned is still around.
+		class Reader {
+			public:
+				Reader(Reader&& other);
+				Reader& operator=(Reader&&) = delete;
+				~Reader();
+				std::optional<Snapshot> read();
+
+			private:
+				Reader(const ConcurrentCrossword& owner, Slot& slot);
+				const ConcurrentCrossword* owner;
+				Slot* slot;
+				friend class ConcurrentCrossword;
+		};
+
+		explicit ConcurrentCrossword(Crossword initial,
+			size_t max_readers = DEFAULT_MAX_READERS);
+		// Readers and snapshots must be gone first.
+		~ConcurrentCrossword();
+		ConcurrentCrossword(const ConcurrentCrossword&) = delete;
+		ConcurrentCrossword& operator=(const ConcurrentCrossword&) = delete;
+
+		// Writer side, all on one thread. Changes to the draft are seen by
+		// readers once published.
+		inline Crossword& draft() {
+			return draft_;
+		}
+		void publish();
+		// Versions replaced but not freed yet, as some reader may hold them.
+		inline size_t unreclaimed() const {
+			return retired.size();
+		}
+
+		// Reader side, from any thread. Returns nothing if max_readers
+		// readers are taken.
+		std::optional<Reader> reader();
+		inline size_t max_readers() const {
+			return slots.size();
+		}
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "crosswords_dictionary.h"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Blocks of a bitset intersected at once: 512 words.
+constexpr size_t CHUNK_BLOCKS = 8;
+constexpr size_t NO_SET = -1;
+
+unsigned char upper(char c) {
+    return ::toupper(static_cast<unsigned char>(c));
+}
+
+// acc &= bits over a chunk. Tells whether any bit is left.
+bool and_chunk(uint64_t *acc, const uint64_t *bits) {
+#if defined(__SSE2__)
+    __m128i any = _mm_setzero_si128();
+    for (size_t i = 0; i < CHUNK_BLOCKS; i += 2) {
+        __m128i *dest = reinterpret_cast<__m128i *>(acc + i);
+        __m128i both = _mm_and_si128(
+            _mm_load_si128(dest),
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(bits + i)));
+        _mm_store_si128(dest, both);
+        any = _mm_or_si128(any, both);
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) !=
+           0xffff;
+#else
+    uint64_t any = 0;
+    for (size_t i = 0; i < CHUNK_BLOCKS; i++)
+        any |= acc[i] &= bits[i];
+    return any != 0;
+#endif
+}
+} // namespace
+
+Dictionary::Dictionary(const std::vector<std::string> &words) {
+    for (const std::string &text : words) {
+        if (text.empty())
+            continue;
+        if (text.size() >= buckets.size())
+            buckets.resize(text.size() + 1);
+        Bucket &bucket = buckets[text.size()];
+        for (char c : text)
+            bucket.letters += upper(c);
+        bucket.count++;
+        word_count++;
+    }
+
+    for (size_t length = 1; length < buckets.size(); length++) {
+        Bucket &bucket = buckets[length];
+        bucket.slot.fill(NO_SLOT);
+        for (unsigned char c : bucket.letters) {
+            if (bucket.slot[c] == NO_SLOT)
+                bucket.slot[c] = bucket.slots++;
+        }
+        size_t chunks = (bucket.count + 64 * CHUNK_BLOCKS - 1) /
+                        (64 * CHUNK_BLOCKS);
+        bucket.blocks = chunks * CHUNK_BLOCKS;
+        size_t sets = length * bucket.slots;
+        bucket.bits = std::make_unique<uint64_t[]>(sets * bucket.blocks);
+        bucket.set_counts.assign(sets, 0);
+        for (size_t i = 0; i < bucket.count; i++) {
+            for (size_t p = 0; p < length; p++) {
+                unsigned char c = bucket.letters[i * length + p];
+                size_t set = p * bucket.slots + bucket.slot[c];
+                bucket.bits[set * bucket.blocks + i / 64] |= uint64_t(1)
+                                                             << i % 64;
+                bucket.set_counts[set]++;
+            }
+        }
+    }
+}
+
+// Calls f(bucket, first, bits) for every chunk of the bucket of pattern
+// holding matches, where bits marks the matching words from the word with
+// index first on. Chunks start from the bitset with the fewest words.
+template <typename F>
+void Dictionary::intersect(std::string_view pattern, F &&f) const {
+    if (pattern.empty() || pattern.size() >= buckets.size())
+        return;
+    const Bucket &bucket = buckets[pattern.size()];
+    if (bucket.count == 0)
+        return;
+
+    size_t sparsest = NO_SET;
+    for (size_t p = 0; p < pattern.size(); p++) {
+        if (pattern[p] == DEFAULT_CHAR)
+            continue;
+        uint8_t slot = bucket.slot[upper(pattern[p])];
+        if (slot == NO_SLOT)
+            return;
+        size_t set = p * bucket.slots + slot;
+        if (sparsest == NO_SET ||
+            bucket.set_counts[set] < bucket.set_counts[sparsest])
+            sparsest = set;
+    }
+
+    alignas(16) uint64_t acc[CHUNK_BLOCKS];
+    for (size_t block = 0; block < bucket.blocks; block += CHUNK_BLOCKS) {
+        bool any = true;
+        if (sparsest == NO_SET) {
+            // Nothing but wildcards: every word of the bucket.
+            for (size_t i = 0; i < CHUNK_BLOCKS; i++) {
+                size_t first = (block + i) * 64;
+                size_t left = bucket.count > first ? bucket.count - first : 0;
+                acc[i] = left >= 64 ? ~uint64_t(0)
+                                    : (uint64_t(1) << left) - 1;
+            }
+        } else {
+            std::fill(acc, acc + CHUNK_BLOCKS, ~uint64_t(0));
+            any = and_chunk(acc,
+                            &bucket.bits[sparsest * bucket.blocks + block]);
+        }
+        for (size_t p = 0; any && p < pattern.size(); p++) {
+            if (pattern[p] == DEFAULT_CHAR)
+                continue;
+            size_t set = p * bucket.slots + bucket.slot[upper(pattern[p])];
+            if (set != sparsest)
+                any = and_chunk(acc,
+                                &bucket.bits[set * bucket.blocks + block]);
+        }
+        if (any)
+            f(bucket, block * 64, static_cast<const uint64_t *>(acc));
+    }
+}
+
+size_t Dictionary::count(std::string_view pattern) const {
+    size_t matching = 0;
+    intersect(pattern,
+              [&matching](const Bucket &, size_t, const uint64_t *bits) {
+                  for (size_t i = 0; i < CHUNK_BLOCKS; i++)
+                      matching += std::popcount(bits[i]);
+              });
+    return matching;
+}
+
+void Dictionary::visit_matches(std::string_view pattern,
+                               void (*visit)(const void *context,
+                                             std::string_view word),
+                               const void *context) const {
+    size_t length = pattern.size();
+    intersect(pattern, [=](const Bucket &bucket, size_t first,
+                           const uint64_t *bits) {
+        for (size_t i = 0; i < CHUNK_BLOCKS; i++) {
+            for (uint64_t left = bits[i]; left != 0; left &= left - 1) {
+                size_t index = first + i * 64 + std::countr_zero(left);
+                visit(context, std::string_view(bucket.letters)
+                                   .substr(index * length, length));
+            }
+        }
+    });
+}
+
+std::vector<std::string_view>
+Dictionary::matches(std::string_view pattern) const {
+    std::vector<std::string_view> found;
+    for_each_match(pattern,
+                   [&found](std::string_view w) { found.push_back(w); });
+    return found;
+}
@@ -0,0 +1,66 @@
+#ifndef CROSSWORDS_DICTIONARY_H
+#define CROSSWORDS_DICTIONARY_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "crosswords.h"
+
+// Words indexed for pattern queries such as "C?D??", where DEFAULT_CHAR
+// stands for any letter and the other letters have to match. Words are
+// bucketed by length, and each bucket keeps a bitset of its words for every
+// letter at every position, so a query intersects one bitset per fixed
+// letter. Words and patterns are upper-cased like the letters of a Word.
+class Dictionary {
+	private:
+		static constexpr uint8_t NO_SLOT = 0xff;
+
+		struct Bucket {
+			size_t count = 0;
+			// 64-bit blocks in every bitset of the bucket, a whole number of the
+			// chunks intersected at once.
+			size_t blocks = 0;
+			// Words of the bucket back to back.
+			std::string letters;
+			// Index of each letter among the letters of the bucket.
+			std::array<uint8_t, 256> slot;
+			size_t slots = 0;
+			// Bitsets by position, then by letter slot, and their counts.
+			std::unique_ptr<uint64_t[]> bits;
+			std::vector<uint32_t> set_counts;
+		};
+
+		std::vector<Bucket> buckets;
+		size_t word_count = 0;
+
+		template <typename F>
+		void intersect(std::string_view pattern, F&& f) const;
+		void visit_matches(std::string_view pattern,
+			void (*visit)(const void* context, std::string_view word),
+			const void* context) const;
+
+	public:
+		explicit Dictionary(const std::vector<std::string>& words);
+		inline size_t size() const {
+			return word_count;
+		}
+
+		// Number of words matching pattern, counted without visiting them.
+		size_t count(std::string_view pattern) const;
+		// Words matching pattern, in the order they were given. The views
+		// stay valid as long as the dictionary. The visitor form calls f with
+		// each of them and allocates nothing.
+		std::vector<std::string_view> matches(std::string_view pattern) const;
+		template <typename F>
+		void for_each_match(std::string_view pattern, F&& f) const {
+			using visitor_t = std::remove_reference_t<F>;
+			visit_matches(pattern, [](const void* context, std::string_view w) {
+				(*static_cast<visitor_t*>(const_cast<void*>(context)))(w);
+			}, std::addressof(f));
+		}
+};
+
+#endif
@@ -0,0 +1,398 @@
+#include "crosswords_fill.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// A dictionary word at a position in a slot, with the number of placed
+// letters it runs through.
+struct Placement {
+    uint32_t word;
+    uint32_t crossings;
+    pos_t start;
+};
+
+struct Slot {
+    pos_t anchor;
+    orientation_t orientation;
+    std::vector<Placement> candidates;
+};
+
+// A state of the search. Every candidate of every slot fits the crossword,
+// and slots left without candidates are dropped: placing words only ever
+// takes candidates away.
+struct Node {
+    Crossword crossword;
+    std::vector<Slot> slots;
+    std::vector<bool> used;
+    size_t words;
+    size_t letters;
+};
+
+pos_t step(pos_t pos, orientation_t orientation, cord_t offset) {
+    if (orientation == H)
+        pos.first += offset;
+    else
+        pos.second += offset;
+    return pos;
+}
+} // namespace
+
+struct CrosswordFiller::Shared {
+    const Clock::time_point deadline;
+    const size_t node_limit;
+    std::atomic<size_t> nodes = 0;
+    std::atomic<size_t> leaves = 0;
+    std::atomic<bool> stop = false;
+    // Read without the lock to skip nodes that cannot be the best.
+    std::atomic<bool> has_best = false;
+    std::atomic<size_t> best_letters = 0;
+
+    std::mutex mutex;
+    std::optional<Crossword> best;
+    size_t best_words = 0;
+
+    Shared(Clock::time_point deadline, size_t node_limit)
+        : deadline(deadline), node_limit(node_limit) {}
+
+    void offer(const Node &node) {
+        if (has_best.load(std::memory_order_acquire) &&
+            node.letters <= best_letters.load(std::memory_order_relaxed))
+            return;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (best.has_value() && node.letters <= best_letters)
+            return;
+        // A layer of its own, so that words placed on node later are not
+        // stacked above the shared ones.
+        best = node.crossword;
+        best->flatten();
+        best_words = node.words;
+        best_letters = node.letters;
+        has_best.store(true, std::memory_order_release);
+    }
+};
+
+// A single thread of the search, with its own copy of the dictionary words
+// to move around while checking them.
+class CrosswordFiller::Search {
+  public:
+    Search(const CrosswordFiller &filler, const RectArea &target,
+           size_t max_branching, Shared &shared)
+        : filler(filler), words{filler.words[H], filler.words[V]},
+          target(target), max_branching(std::max<size_t>(max_branching, 1)),
+          shared(shared) {}
+
+    Node root(const Crossword &start);
+    // Counts node, offers it as the best one and tells whether the search
+    // goes on.
+    bool visit(const Node &node);
+    // Searches the subtree of node depth first. Words are placed on the
+    // crossword of node and marked in its used words on the way down, and
+    // taken back on the way up.
+    void explore(Node &node);
+    // All children of node: the best scored placements in its most
+    // constrained slot, then node itself without the slot.
+    std::vector<Node> branches(Node &node);
+
+  private:
+    const CrosswordFiller &filler;
+    std::vector<Word> words[2];
+    const RectArea target;
+    const size_t max_branching;
+    Shared &shared;
+
+    Word &placed(orientation_t orientation, const Placement &p) {
+        Word &w = words[orientation][p.word];
+        w.wordStart = p.start;
+        return w;
+    }
+    bool fits(const Crossword &cr, const Word &w,
+              Crossword::LayerCursors &cursors, uint32_t &crossings) const;
+    void open_slot(const Crossword &cr, const std::vector<bool> &used,
+                   pos_t anchor, orientation_t orientation, char letter,
+                   Crossword::LayerCursors &cursors, std::vector<Slot> &slots);
+    size_t most_constrained(const Node &node) const;
+    std::vector<Placement> ranked(const Slot &slot) const;
+    size_t letters_added(const Slot &slot, const Placement &p) const {
+        return filler.words[slot.orientation][p.word].length() - p.crossings;
+    }
+    std::vector<Slot> place(Crossword &cr, std::vector<bool> &used,
+                            const std::vector<Slot> &slots, size_t slot,
+                            const Placement &p);
+};
+
+bool CrosswordFiller::Search::fits(const Crossword &cr, const Word &w,
+                                   Crossword::LayerCursors &cursors,
+                                   uint32_t &crossings) const {
+    pos_t start = w.get_start_position();
+    pos_t end = w.get_end_position();
+    pos_t lt = target.get_left_top();
+    pos_t rb = target.get_right_bottom();
+    if (end < start || start.first < lt.first || start.second < lt.second ||
+        end.first > rb.first || end.second > rb.second)
+        return false;
+    if (cr.does_collide(w, cursors))
+        return false;
+
+    crossings = 0;
+    for (size_t i = 0; i < w.length(); i++)
+        crossings += cr.letter_at(w.pos_of_letter(i), cursors).has_value();
+    // A word running only over placed letters is already there.
+    return crossings < w.length();
+}
+
+void CrosswordFiller::Search::open_slot(const Crossword &cr,
+                                        const std::vector<bool> &used,
+                                        pos_t anchor, orientation_t orientation,
+                                        char letter,
+                                        Crossword::LayerCursors &cursors,
+                                        std::vector<Slot> &slots) {
+    Slot slot = {anchor, orientation, {}};
+    cord_t along = orientation == H ? anchor.first : anchor.second;
+    for (auto [word, offset] : filler.by_letter[(unsigned char) letter]) {
+        if (offset > along || used[word])
+            continue;
+        Placement p = {word, 0, anchor};
+        (orientation == H ? p.start.first : p.start.second) -= offset;
+        if (fits(cr, placed(orientation, p), cursors, p.crossings))
+            slot.candidates.push_back(p);
+    }
+    if (!slot.candidates.empty())
+        slots.push_back(std::move(slot));
+}
+
+Node CrosswordFiller::Search::root(const Crossword &start) {
+    Node node = {start, {}, std::vector<bool>(filler.words[H].size()), 0, 0};
+    std::vector<std::pair<pos_t, orientation_t>> letters;
+    start.for_each_word_in(start.area, [&letters](const Word &w) {
+        for (size_t i = 0; i < w.length(); i++)
+            letters.push_back({w.pos_of_letter(i), w.get_orientation()});
+    });
+    std::sort(letters.begin(), letters.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    Crossword::LayerCursors cursors = {};
+    for (size_t i = 0; i < letters.size(); i++) {
+        auto [pos, orientation] = letters[i];
+        if (i > 0 && letters[i - 1].first == pos)
+            continue;
+        node.letters++;
+        orientation_t across = orientation == H ? V : H;
+        open_slot(node.crossword, node.used, pos, across,
+                  *start.letter_at(pos, cursors), cursors, node.slots);
+    }
+    return node;
+}
+
+bool CrosswordFiller::Search::visit(const Node &node) {
+    if (shared.stop.load(std::memory_order_relaxed))
+        return false;
+    size_t nodes = shared.nodes.fetch_add(1, std::memory_order_relaxed) + 1;
+    // A node costs far more than reading the clock.
+    if (nodes >= shared.node_limit || Clock::now() >= shared.deadline)
+        shared.stop = true;
+    shared.offer(node);
+    return !shared.stop.load(std::memory_order_relaxed);
+}
+
+size_t CrosswordFiller::Search::most_constrained(const Node &node) const {
+    size_t best = 0;
+    for (size_t i = 1; i < node.slots.size(); i++) {
+        if (node.slots[i].candidates.size() <
+            node.slots[best].candidates.size())
+            best = i;
+    }
+    return best;
+}
+
+// Candidates crossing more placed letters come first, then longer ones.
+std::vector<Placement>
+CrosswordFiller::Search::ranked(const Slot &slot) const {
+    std::vector<Placement> order = slot.candidates;
+    const std::vector<Word> &dictionary = filler.words[slot.orientation];
+    auto better = [&dictionary](const Placement &a, const Placement &b) {
+        if (a.crossings != b.crossings)
+            return a.crossings > b.crossings;
+        return dictionary[a.word].length() > dictionary[b.word].length();
+    };
+    size_t count = std::min(max_branching, order.size());
+    std::partial_sort(order.begin(), order.begin() + count, order.end(),
+                      better);
+    order.resize(count);
+    return order;
+}
+
+// Places p in the slot on cr and marks its word used. Returns the slots
+// left: the others, with the candidates that still fit, and new ones
+// across the letters the word adds.
+std::vector<Slot> CrosswordFiller::Search::place(Crossword &cr,
+                                                 std::vector<bool> &used,
+                                                 const std::vector<Slot> &slots,
+                                                 size_t slot,
+                                                 const Placement &p) {
+    orientation_t orientation = slots[slot].orientation;
+    const Word &w = filler.words[orientation][p.word];
+    Crossword::LayerCursors cursors = {};
+    std::vector<size_t> added;
+    added.reserve(w.length());
+    for (size_t i = 0; i < w.length(); i++) {
+        if (!cr.letter_at(step(p.start, orientation, i), cursors).has_value())
+            added.push_back(i);
+    }
+    used[p.word] = true;
+    cr.make_writable();
+    Crossword::InsertCursor cursor;
+    cr.insert_word(placed(orientation, p), false, cursor);
+    const RectArea rect = placed(orientation, p).rect_area();
+
+    std::vector<Slot> left;
+    left.reserve(slots.size() + added.size());
+    cursors = {};
+    for (size_t i = 0; i < slots.size(); i++) {
+        const Slot &other = slots[i];
+        if (i == slot || (other.orientation == orientation &&
+                          !(rect * RectArea(other.anchor, other.anchor)).empty()))
+            continue;
+        Slot kept = {other.anchor, other.orientation, {}};
+        for (const Placement &q : other.candidates) {
+            if (q.word == p.word)
+                continue;
+            const Word &v = placed(other.orientation, q);
+            if ((with_margin(v.rect_area()) * rect).empty())
+                kept.candidates.push_back(q);
+            else if (Placement r = q; fits(cr, v, cursors, r.crossings))
+                kept.candidates.push_back(r);
+        }
+        if (!kept.candidates.empty())
+            left.push_back(std::move(kept));
+    }
+
+    orientation_t across = orientation == H ? V : H;
+    for (size_t i : added)
+        open_slot(cr, used, step(p.start, orientation, i), across, w.at(i),
+                  cursors, left);
+    return left;
+}
+
+// Each child gets a copy of the crossword sharing its words, and of the
+// used words, so that children can be searched apart.
+std::vector<Node> CrosswordFiller::Search::branches(Node &node) {
+    std::vector<Node> children;
+    size_t slot = most_constrained(node);
+    for (const Placement &p : ranked(node.slots[slot])) {
+        Node child = {node.crossword, {}, node.used, node.words + 1,
+                      node.letters + letters_added(node.slots[slot], p)};
+        child.slots = place(child.crossword, child.used, node.slots, slot, p);
+        children.push_back(std::move(child));
+    }
+    node.slots.erase(node.slots.begin() + slot);
+    children.push_back(std::move(node));
+    return children;
+}
+
+// A child takes the place of node while it is searched: its slots are
+// swapped in, and its word is rolled back from the crossword after. The
+// crossword is flattened first if shared, so that placements go to one
+// layer and are undone without leaving erased words.
+void CrosswordFiller::Search::explore(Node &node) {
+    if (!visit(node))
+        return;
+    if (node.crossword.store.use_count() > 1)
+        node.crossword.flatten();
+    while (!node.slots.empty()) {
+        size_t slot = most_constrained(node);
+        for (const Placement &p : ranked(node.slots[slot])) {
+            size_t letters = node.letters;
+            node.letters += letters_added(node.slots[slot], p);
+            node.words++;
+            Crossword::checkpoint_t token = node.crossword.checkpoint();
+            std::vector<Slot> slots =
+                place(node.crossword, node.used, node.slots, slot, p);
+            std::swap(node.slots, slots);
+            explore(node);
+            std::swap(node.slots, slots);
+            node.crossword.rollback(token);
+            node.used[p.word] = false;
+            node.words--;
+            node.letters = letters;
+            if (shared.stop.load(std::memory_order_relaxed))
+                return;
+        }
+        node.slots.erase(node.slots.begin() + slot);
+        if (!visit(node))
+            return;
+    }
+    shared.leaves++;
+}
+
+CrosswordFiller::CrosswordFiller(const std::vector<std::string> &dictionary) {
+    for (const std::string &text : dictionary) {
+        if (text.empty())
+            continue;
+        uint32_t index = words[H].size();
+        words[H].emplace_back(0, 0, H, std::string(text));
+        words[V].emplace_back(0, 0, V, std::string(text));
+        const Word &w = words[H].back();
+        for (size_t i = 0; i < w.length(); i++)
+            by_letter[(unsigned char) w.at(i)].push_back({index, i});
+    }
+}
+
+// With more threads, the top of the tree is expanded breadth first until
+// there are a few subtrees for every thread, which are then dealt out.
+Crossword CrosswordFiller::fill(const Crossword &start, const RectArea &target,
+                                const FillLimits &limits) {
+    Clock::time_point started = Clock::now();
+    Shared shared(started + limits.time_limit, limits.node_limit);
+    size_t threads = std::max<size_t>(limits.threads, 1);
+    Search first(*this, target, limits.max_branching, shared);
+
+    std::deque<Node> frontier;
+    frontier.push_back(first.root(start));
+    if (threads == 1) {
+        first.explore(frontier.front());
+    } else {
+        std::vector<Node> subtrees;
+        while (!frontier.empty() && frontier.size() < 4 * threads) {
+            Node node = std::move(frontier.front());
+            frontier.pop_front();
+            if (!first.visit(node))
+                break;
+            if (node.slots.empty()) {
+                shared.leaves++;
+                continue;
+            }
+            for (Node &child : first.branches(node))
+                frontier.push_back(std::move(child));
+        }
+
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([this, &target, &limits, &shared, &frontier,
+                                  t, threads]() {
+                Search search(*this, target, limits.max_branching, shared);
+                for (size_t i = t; i < frontier.size(); i += threads)
+                    search.explore(frontier[i]);
+            });
+        }
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    std::chrono::duration<double> elapsed = Clock::now() - started;
+    last_stats.nodes = shared.nodes;
+    last_stats.leaves = shared.leaves;
+    last_stats.seconds = elapsed.count();
+    if (!shared.best.has_value()) {
+        last_stats.words = last_stats.letters = 0;
+        return start;
+    }
+    last_stats.words = shared.best_words;
+    last_stats.letters = shared.best_letters;
+    return *shared.best;
+}
@@ -0,0 +1,57 @@
+#ifndef CROSSWORDS_FILL_H
+#define CROSSWORDS_FILL_H
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+#include "crosswords.h"
+
+struct FillLimits {
+	size_t threads = 1;
+	std::chrono::milliseconds time_limit{1000};
+	size_t node_limit = (size_t) -1;
+	// Candidates tried for a slot, best scored first, before the search
+	// moves on leaving the slot empty.
+	size_t max_branching = 4;
+};
+
+struct FillStats {
+	size_t nodes = 0;
+	size_t leaves = 0;
+	// Words added and letters covered by the best crossword found.
+	size_t words = 0;
+	size_t letters = 0;
+	double seconds = 0;
+
+	inline double nodes_per_second() const {
+		return seconds > 0 ? nodes / seconds : 0;
+	}
+};
+
+// Grows a crossword with words from a dictionary, keeping every word within
+// a target area. A slot is a letter of a placed word not crossed yet;
+// the search fills the slot with the fewest fitting words first, trying
+// the words crossing the most letters first, and keeps the crossword that
+// covers the most cells. Words are checked with the collision rules of
+// Crossword, and each is used at most once.
+class CrosswordFiller {
+	public:
+		explicit CrosswordFiller(const std::vector<std::string>& dictionary);
+		Crossword fill(const Crossword& start, const RectArea& target,
+			const FillLimits& limits = {});
+		inline const FillStats& stats() const {
+			return last_stats;
+		}
+	private:
+		class Search;
+		struct Shared;
+
+		// Dictionary words by orientation, placed at the origin.
+		std::vector<Word> words[2];
+		// Words holding each letter, with the offset of the letter.
+		std::vector<std::pair<uint32_t, uint32_t>> by_letter[256];
+		FillStats last_stats;
+};
+
+#endif
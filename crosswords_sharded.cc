@@ -0,0 +1,253 @@
+#include "crosswords_sharded.h"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace {
+bool inside(const RectArea &rect, pos_t pos) {
+    pos_t lt = rect.get_left_top();
+    pos_t rb = rect.get_right_bottom();
+    return lt.first <= pos.first && pos.first <= rb.first &&
+           lt.second <= pos.second && pos.second <= rb.second;
+}
+
+void add(dim_t &to, dim_t from, dim_t before) {
+    to.first += from.first - before.first;
+    to.second += from.second - before.second;
+}
+} // namespace
+
+// Words of the batch, the shards each of them reaches into, and for the
+// words reaching into several, how many of those have not got to it yet.
+struct ShardedCrossword::Batch {
+    std::span<const Word> words;
+    std::vector<Shard *> reached;
+    std::vector<size_t> first_reached;
+    std::unique_ptr<std::atomic<uint32_t>[]> waiting;
+    std::vector<char> accepted;
+    std::atomic<size_t> unfinished;
+
+    std::span<Shard *const> reached_by(size_t i) const {
+        return std::span<Shard *const>(reached).subspan(
+            first_reached[i], first_reached[i + 1] - first_reached[i]);
+    }
+};
+
+ShardedCrossword::Shard::Shard(const RectArea &cells) : cells(cells) {}
+
+ShardedCrossword::ShardedCrossword(cord_t shard_side)
+    : shard_side(shard_side), area(DEFAULT_EMPTY_RECT_AREA) {
+    if (shard_side < 1)
+        throw std::invalid_argument("shard side must be positive");
+}
+
+ShardedCrossword::Shard &ShardedCrossword::shard_at(pos_t pos) {
+    pos_t key(pos.first / shard_side, pos.second / shard_side);
+    auto it = shards.find(key);
+    if (it != shards.end())
+        return it->second;
+    auto last = [this](cord_t first) {
+        return MAX_COORDINATE - first < shard_side - 1
+                   ? MAX_COORDINATE
+                   : first + (shard_side - 1);
+    };
+    pos_t lt(key.first * shard_side, key.second * shard_side);
+    RectArea cells(lt, {last(lt.first), last(lt.second)});
+    return shards.try_emplace(key, cells).first->second;
+}
+
+const ShardedCrossword::Shard *ShardedCrossword::find_shard(pos_t pos) const {
+    auto it = shards.find({pos.first / shard_side, pos.second / shard_side});
+    return it == shards.end() ? nullptr : &it->second;
+}
+
+std::optional<char> ShardedCrossword::letter_at(pos_t pos) const {
+    const Shard *shard = find_shard(pos);
+    if (shard == nullptr)
+        return std::nullopt;
+    Crossword::LayerCursors cursors;
+    return shard->crossword.letter_at(pos, cursors);
+}
+
+// Checks w the way Crossword::does_collide does, reading each cell from
+// the shard it lies in. A word running over w shares a cell with it, so it
+// is stored in one of the shards reached.
+bool ShardedCrossword::insert_shared(const Word &w,
+                                     std::span<Shard *const> reached) {
+    std::vector<Crossword::LayerCursors> cursors(reached.size());
+    auto letter = [&](pos_t pos) -> std::optional<char> {
+        for (size_t i = 0; i < reached.size(); i++) {
+            if (inside(reached[i]->cells, pos))
+                return reached[i]->crossword.letter_at(pos, cursors[i]);
+        }
+        return std::nullopt;
+    };
+    if (collides_with_letters(w, letter))
+        return false;
+    for (Shard *shard : reached) {
+        if (shard->crossword.overlaps_parallel(w))
+            return false;
+    }
+
+    for (Shard *shard : reached) {
+        dim_t before = shard->crossword.word_count();
+        Crossword::InsertCursor cursor;
+        shard->crossword.adopt_word(w, cursor);
+        if (inside(shard->cells, w.get_start_position()))
+            add(shard->owned, shard->crossword.word_count(), before);
+    }
+    return true;
+}
+
+template <typename Resume>
+void ShardedCrossword::run(Shard &shard, Batch &batch, Resume &&resume) {
+    Crossword::InsertCursor cursor;
+    size_t handled = 0;
+    while (shard.next < shard.queue.size()) {
+        size_t i = shard.queue[shard.next];
+        const Word &w = batch.words[i];
+        std::span<Shard *const> reached = batch.reached_by(i);
+        if (reached.size() == 1) {
+            dim_t before = shard.crossword.word_count();
+            batch.accepted[i] = shard.crossword.insert_word(w, true, cursor);
+            add(shard.owned, shard.crossword.word_count(), before);
+            shard.next++;
+            handled++;
+            continue;
+        }
+        if (batch.waiting[i].fetch_sub(1) != 1)
+            break;
+        batch.accepted[i] = insert_shared(w, reached);
+        cursor = {};
+        for (Shard *other : reached) {
+            other->next++;
+            if (other != &shard)
+                resume(other);
+        }
+        handled++;
+    }
+    batch.unfinished -= handled;
+}
+
+// Each thread takes shards to run from the back of its own queue, or
+// steals them from the front of another's, and queues the shards it
+// resumes for itself. Shards waiting for others are in no queue.
+std::vector<size_t> ShardedCrossword::insert_words(std::span<const Word> words,
+                                                   size_t threads) {
+    Batch batch;
+    batch.words = words;
+    batch.first_reached.reserve(words.size() + 1);
+    batch.first_reached.push_back(0);
+    batch.waiting = std::make_unique<std::atomic<uint32_t>[]>(words.size());
+    batch.accepted.assign(words.size(), false);
+    for (size_t i = 0; i < words.size(); i++) {
+        RectArea reach = with_margin(words[i].rect_area());
+        pos_t first = reach.get_left_top();
+        pos_t last = reach.get_right_bottom();
+        first = {first.first / shard_side, first.second / shard_side};
+        last = {last.first / shard_side, last.second / shard_side};
+        // The last shard may be the one at the edge of the space, past
+        // which the coordinates wrap around.
+        for (cord_t y = first.second;; y++) {
+            for (cord_t x = first.first;; x++) {
+                Shard &shard = shard_at({x * shard_side, y * shard_side});
+                shard.queue.push_back(i);
+                batch.reached.push_back(&shard);
+                if (x == last.first)
+                    break;
+            }
+            if (y == last.second)
+                break;
+        }
+        batch.first_reached.push_back(batch.reached.size());
+        batch.waiting[i] = batch.reached_by(i).size();
+    }
+    batch.unfinished = words.size();
+
+    struct Worker {
+        std::mutex lock;
+        std::deque<Shard *> shards;
+    };
+    threads = std::max<size_t>(threads, 1);
+    std::vector<Worker> workers(threads);
+    size_t dealt = 0;
+    for (auto &[key, shard] : shards) {
+        if (shard.queue.empty())
+            continue;
+        shard.crossword.make_writable();
+        workers[dealt++ % threads].shards.push_back(&shard);
+    }
+
+    auto take = [&workers, threads](size_t self) -> Shard * {
+        for (size_t k = 0; k < threads; k++) {
+            Worker &worker = workers[(self + k) % threads];
+            std::lock_guard<std::mutex> guard(worker.lock);
+            if (worker.shards.empty())
+                continue;
+            Shard *shard;
+            if (k == 0) {
+                shard = worker.shards.back();
+                worker.shards.pop_back();
+            } else {
+                shard = worker.shards.front();
+                worker.shards.pop_front();
+            }
+            return shard;
+        }
+        return nullptr;
+    };
+    auto work = [&](size_t self) {
+        auto resume = [&workers, self](Shard *shard) {
+            std::lock_guard<std::mutex> guard(workers[self].lock);
+            workers[self].shards.push_back(shard);
+        };
+        while (batch.unfinished > 0) {
+            if (Shard *shard = take(self))
+                run(*shard, batch, resume);
+            else
+                std::this_thread::yield();
+        }
+    };
+    std::vector<std::thread> helpers;
+    for (size_t t = 1; t < threads; t++)
+        helpers.emplace_back(work, t);
+    work(0);
+    for (std::thread &helper : helpers)
+        helper.join();
+
+    std::vector<size_t> rejected;
+    for (size_t i = 0; i < words.size(); i++) {
+        if (!batch.accepted[i])
+            rejected.push_back(i);
+    }
+    for (auto &[key, shard] : shards) {
+        if (shard.queue.empty())
+            continue;
+        shard.queue.clear();
+        shard.next = 0;
+        if (!shard.crossword.area.empty()) {
+            area.embrace(shard.crossword.area.get_left_top());
+            area.embrace(shard.crossword.area.get_right_bottom());
+        }
+    }
+    return rejected;
+}
+
+dim_t ShardedCrossword::word_count() const {
+    dim_t count(0, 0);
+    for (const auto &[key, shard] : shards)
+        add(count, shard.owned, {0, 0});
+    return count;
+}
+
+// Each word is taken from the shard its start lies in.
+Crossword ShardedCrossword::to_crossword() const {
+    Crossword cr;
+    Crossword::InsertCursor cursor;
+    for (const auto &[key, shard] : shards)
+        cr.adopt_words(shard.crossword, shard.cells, cursor);
+    return cr;
+}
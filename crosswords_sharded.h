@@ -0,0 +1,75 @@
+#ifndef CROSSWORDS_SHARDED_H
+#define CROSSWORDS_SHARDED_H
+
+#include <atomic>
+#include <map>
+#include <optional>
+#include <span>
+#include <vector>
+#include "crosswords.h"
+
+// A crossword split into square shards of the plane, each a Crossword of
+// its own, filled on several threads. A word whose cells and spacing
+// margin lie within one shard is checked and stored there alone. A word
+// reaching into several shards is checked against all of them at once,
+// cell by cell from the shard owning each cell, and then stored in each
+// of them. The words of a shard are handled in input order, and a word
+// reaching into several shards waits for all of them to get to it, so
+// every word is accepted or rejected exactly as by Crossword::insert_words
+// with the same input.
+class ShardedCrossword {
+	private:
+		struct Shard {
+			Crossword crossword;
+			RectArea cells;
+			// Words stored with their start in the shard, counted once for the
+			// whole crossword.
+			dim_t owned{0, 0};
+			// Indices of the words of the current batch reaching into the
+			// shard, and the next one to handle.
+			std::vector<size_t> queue;
+			size_t next = 0;
+
+			explicit Shard(const RectArea& cells);
+		};
+
+		struct Batch;
+
+		cord_t shard_side;
+		std::map<pos_t, Shard> shards;
+		RectArea area;
+
+		Shard& shard_at(pos_t pos);
+		const Shard* find_shard(pos_t pos) const;
+		// Handles the words of the shard from its next one on, until it gets
+		// to a word also reaching into other shards that not all of them have
+		// got to yet. The last to get there handles the word and resumes the
+		// others through resume.
+		template <typename Resume>
+		void run(Shard& shard, Batch& batch, Resume&& resume);
+		bool insert_shared(const Word& w, std::span<Shard* const> reached);
+
+	public:
+		static constexpr cord_t DEFAULT_SHARD_SIDE = 1024;
+
+		// Throws std::invalid_argument unless shard_side is positive.
+		explicit ShardedCrossword(cord_t shard_side = DEFAULT_SHARD_SIDE);
+
+		// Inserts the words on the given number of threads, skipping the
+		// colliding ones, and returns the indices of the skipped words.
+		std::vector<size_t> insert_words(std::span<const Word> words,
+			size_t threads);
+
+		inline dim_t size() const {
+			return area.size();
+		}
+		dim_t word_count() const;
+		inline size_t shard_count() const {
+			return shards.size();
+		}
+		std::optional<char> letter_at(pos_t pos) const;
+		// A single Crossword with the same words.
+		Crossword to_crossword() const;
+};
+
+#endif
@@ -4,10 +4,27 @@
  * Author:      Przemysław Rutka
  */
 
+#include <atomic>
 #include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <list>
+#include <map>
+#include <new>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
 #include <utility>
 #include "crosswords.h"
+#include "crosswords_concurrent.h"
+#include "crosswords_sharded.h"
+#include "crosswords_dictionary.h"
+#include "crosswords_fill.h"
 
 #define WORD_BASIC_ASSERTS(w, sp, ep, o, ci, c, l) \
 do { \
@@ -37,6 +54,9 @@ namespace {
     using orientation_t::V;
     using std::cout;
 
+    // Counted by the operator new below, on any thread.
+    std::atomic<size_t> allocations{0};
+
     void crossword_tests() {
         Word w1(0, 0, H, "syrop");
         Word w2(0, 0, V, "Ssak");
@@ -57,8 +77,1437 @@ namespace {
         cr3 += cr2;
         cout << cr3 << std::endl;
     }
+
+    std::string render(const Crossword &cr) {
+        std::ostringstream out;
+        out << cr;
+        return out.str();
+    }
+
+    void storage_tests() {
+        Crossword cr(Word(0, 0, H, "a rather long first word"), {});
+        for (size_t i = 1; i <= 1000; i++)
+            assert(cr.insert_word(Word(0, 2 * i, H, "another long word")));
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(24, 2001), dim_t(1001, 0));
+
+        // Identical words are accepted, but stored only once.
+        assert(cr.insert_word(Word(0, 2, H, "another long word")));
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(24, 2001), dim_t(1001, 0));
+
+        Crossword copy(cr);
+        CROSSWORD_DIM_ASSERTS(copy, dim_t(24, 2001), dim_t(1001, 0));
+        Crossword moved(std::move(copy));
+        CROSSWORD_DIM_ASSERTS(moved, dim_t(24, 2001), dim_t(1001, 0));
+        assert(copy.word_count() == dim_t(0, 0));
+
+        // Moving allocates nothing, and what is left behind is empty until
+        // written to.
+        static_assert(std::is_nothrow_move_constructible_v<Crossword>);
+        size_t before = allocations;
+        Crossword twice(std::move(moved));
+        moved = std::move(twice);
+        Crossword hollow(std::move(copy));
+        assert(allocations == before);
+        CROSSWORD_DIM_ASSERTS(moved, dim_t(24, 2001), dim_t(1001, 0));
+        CROSSWORD_DIM_ASSERTS(twice, dim_t(0, 0), dim_t(0, 0));
+        CROSSWORD_DIM_ASSERTS(hollow, dim_t(0, 0), dim_t(0, 0));
+        assert(copy.insert_word(Word(3, 1, H, "ab")));
+        CROSSWORD_DIM_ASSERTS(copy, dim_t(2, 1), dim_t(1, 0));
+        CROSSWORD_DIM_ASSERTS(hollow, dim_t(0, 0), dim_t(0, 0));
+        assert(render(copy) == render(Crossword(Word(3, 1, H, "ab"), {})));
+
+        moved += moved;
+        CROSSWORD_DIM_ASSERTS(moved, dim_t(24, 2001), dim_t(1001, 0));
+        cr = moved + Crossword(Word(30, 0, V, "apart"), {});
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(31, 2001), dim_t(1001, 1));
+        cr = cr;
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(31, 2001), dim_t(1001, 1));
+
+        // Up to 16 letters are kept inside the word, more go out of line.
+        assert(sizeof(Word) <= 40);
+        Word short_word(1, 2, V, "sixteen letters!");
+        Word long_word(3, 4, H, "seventeen letters");
+        Word copy_of_long(long_word);
+        short_word = long_word;
+        long_word = Word(5, 6, V, "tiny");
+        WORD_BASIC_ASSERTS(short_word, pos_t(3, 4), pos_t(19, 4), H, 16, 'S', 17);
+        WORD_BASIC_ASSERTS(copy_of_long, pos_t(3, 4), pos_t(19, 4), H, 8, 'N', 17);
+        WORD_BASIC_ASSERTS(long_word, pos_t(5, 6), pos_t(5, 9), V, 3, 'Y', 4);
+        static_assert(std::is_nothrow_move_constructible_v<Word> &&
+                      std::is_nothrow_move_assignable_v<Word>);
+        Word moved_long(std::move(copy_of_long));
+        WORD_BASIC_ASSERTS(moved_long, pos_t(3, 4), pos_t(19, 4), H, 0, 'S', 17);
+        Word moved_short(std::move(long_word));
+        WORD_BASIC_ASSERTS(moved_short, pos_t(5, 6), pos_t(5, 9), V, 3, 'Y', 4);
+        assert(long_word.length() == 0);
+        long_word = std::move(moved_long);
+        WORD_BASIC_ASSERTS(long_word, pos_t(3, 4), pos_t(19, 4), H, 0, 'S', 17);
+        moved_long = std::move(moved_short);
+        WORD_BASIC_ASSERTS(moved_long, pos_t(5, 6), pos_t(5, 9), V, 3, 'Y', 4);
+        Crossword letters(long_word, {Word(3, 3, V, "sixteen letters!")});
+        assert(render(letters).find("S E V E N T E E N") != std::string::npos);
+        // Only ASCII letters are upper-cased.
+        Word accented(0, 0, H, "\xe9t\xe9");
+        assert(accented.at(0) == '\xe9' && accented.at(1) == 'T');
+    }
+
+    void cell_index_tests() {
+        const cord_t M = MAX_COORDINATE;
+        Crossword cr(Word(M - 3, M - 1, H, "edge"), {Word(M, M - 4, V, "ante")});
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(4, 4), dim_t(1, 1));
+        assert(!cr.insert_word(Word(M - 3, M, H, "abc")));
+        assert(!cr.insert_word(Word(M - 2, M - 3, V, "ox")));
+        assert(cr.insert_word(Word(M - 2, M - 2, V, "odd")));
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(4, 5), dim_t(1, 2));
+
+        // Tiles are addressed by coordinate, so far apart words never meet.
+        assert(cr.insert_word(Word(0, 0, H, "origin")));
+        assert(cr.insert_word(Word(M / 2, 15, V, "middle")));
+        assert(!cr.insert_word(Word(M / 2 + 1, 16, V, "touch")));
+        assert(cr.word_count() == dim_t(2, 3));
+
+        // A word running over a parallel one is no crossing, even if the
+        // letters agree; only the very same word is accepted again.
+        Crossword line(Word(16, 13, V, "11"), {});
+        assert(!line.insert_word(Word(16, 12, V, "1111")));
+        assert(!line.insert_word(Word(16, 13, V, "111")));
+        assert(line.insert_word(Word(16, 13, V, "11")));
+        CROSSWORD_DIM_ASSERTS(line, dim_t(1, 2), dim_t(0, 1));
+    }
+
+    void render_tests() {
+        Crossword cr(Word(1, 0, V, "ab1"), {Word(0, 2, H, "x1z"),
+                                            Word(4, 1, V, "qq")});
+        std::ostringstream out;
+        out << cr;
+        assert(out.str() == ". . . . . . .\n"
+                            ". . A . . . .\n"
+                            ". . B . . Q .\n"
+                            ". X ? Z . Q .\n"
+                            ". . . . . . .\n");
+    }
+
+    void bulk_insert_tests() {
+        Crossword cr(Word(1, 1, H, "computer"), {});
+        std::vector<Word> batch = {Word(3, 1, V, "memory"), Word(4, 1, V, "xx"),
+                                   Word(11, 3, V, "linux"), Word(3, 1, V, "m")};
+        std::vector<size_t> rejected = cr.insert_words(batch);
+        assert(rejected == std::vector<size_t>({1, 3}));
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(11, 7), dim_t(1, 2));
+
+        std::list<Word> more = {Word(2, 4, H, "programme"),
+                                Word(2, 5, H, "programming")};
+        rejected = cr.insert_words(more.begin(), more.end());
+        assert(rejected == std::vector<size_t>({0}));
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(12, 7), dim_t(2, 2));
+        assert(cr.insert_words(std::vector<Word>()).empty());
+    }
+
+    // Deterministic pseudo-random words scattered over a square.
+    std::vector<Word> random_words(size_t count, cord_t offset, cord_t side,
+                                   unsigned seed) {
+        std::vector<Word> words;
+        for (size_t i = 0; i < count; i++) {
+            seed = seed * 1103515245 + 12345;
+            cord_t x = offset + (seed >> 8) % side;
+            cord_t y = offset + (seed >> 16) % side;
+            std::string content(2 + (seed >> 4) % 5, 'a' + (seed >> 20) % 3);
+            words.emplace_back(x, y, (seed >> 3) & 1 ? H : V, std::move(content));
+        }
+        return words;
+    }
+
+    void merge_tests() {
+        for (cord_t offset : {0, 5, 20, 30, 31, 32, 100}) {
+            std::vector<Word> a_words = random_words(60, 10, 20, offset + 1);
+            std::vector<Word> b_words = random_words(60, offset, 20, offset + 7);
+            Crossword a(a_words[0], {});
+            a.insert_words(a_words);
+            Crossword b(b_words[0], {});
+            std::vector<size_t> rejected = b.insert_words(b_words);
+
+            Crossword expected = a;
+            expected.insert_word(b_words[0]);
+            for (size_t i = 0, r = 0; i < b_words.size(); i++) {
+                if (r < rejected.size() && rejected[r] == i)
+                    r++;
+                else
+                    expected.insert_word(b_words[i]);
+            }
+
+            Crossword merged = a + b;
+            assert(merged.word_count() == expected.word_count());
+            assert(merged.size() == expected.size());
+            assert(render(merged) == render(expected));
+
+            for (size_t threads : {2, 3, 8}) {
+                Crossword parallel = a;
+                parallel.merge(b, threads);
+                assert(parallel.word_count() == expected.word_count());
+                assert(render(parallel) == render(expected));
+            }
+        }
+    }
+
+    void sharing_tests() {
+        Crossword base(Word(0, 0, H, "base"), {Word(0, 0, V, "bark")});
+        std::string base_render = render(base);
+
+        Crossword variant = base;
+        assert(variant.insert_word(Word(3, 0, V, "echo")));
+        assert(base.insert_word(Word(2, 2, H, "rim")));
+        CROSSWORD_DIM_ASSERTS(variant, dim_t(4, 4), dim_t(1, 2));
+        CROSSWORD_DIM_ASSERTS(base, dim_t(5, 4), dim_t(2, 1));
+        assert(render(Crossword(Word(0, 0, H, "base"),
+                                {Word(0, 0, V, "bark"), Word(3, 0, V, "echo")})) ==
+               render(variant));
+
+        // Words already in a shared layer are found from the layers above.
+        assert(!variant.insert_word(Word(1, 0, V, "xy")));
+        assert(variant.insert_word(Word(0, 0, V, "bark")));
+        CROSSWORD_DIM_ASSERTS(variant, dim_t(4, 4), dim_t(1, 2));
+
+        // A long chain of forks gets flattened along the way.
+        Crossword chain = base;
+        std::vector<Crossword> forks;
+        for (cord_t i = 0; i < 3 * WordStore::MAX_DEPTH; i++) {
+            forks.push_back(chain);
+            assert(chain.insert_word(Word(10, 2 * i, H, "link")));
+            assert(forks.back().word_count() == dim_t(2 + i, 1));
+        }
+        CROSSWORD_DIM_ASSERTS(chain, dim_t(14, 47), dim_t(2 + 24, 1));
+        assert(!chain.insert_word(Word(11, 1, V, "xx")));
+        assert(chain.insert_word(Word(11, 0, V, "ixi")));
+
+        Crossword merged = forks[5] + variant;
+        CROSSWORD_DIM_ASSERTS(merged, dim_t(14, 9), dim_t(2 + 5, 1));
+        assert(render(base) != base_render);
+
+        // Over a much larger bottom layer, only the top layers are merged,
+        // and the bottom one stays shared.
+        Crossword large(Word(0, 0, H, "bottom"), {});
+        Crossword expected(Word(0, 0, H, "bottom"), {});
+        for (cord_t i = 1; i < 200; i++) {
+            assert(large.insert_word(Word(0, 2 * i, H, "row")));
+            if (i != 1)
+                expected.insert_word(Word(0, 2 * i, H, "row"));
+        }
+        const Word *bottom = large.words_in(RectArea({0, 0}, {0, 0}))[0];
+        Crossword grown = large;
+        forks.clear();
+        for (cord_t i = 0; i < 3 * WordStore::MAX_DEPTH; i++) {
+            forks.push_back(grown);
+            assert(grown.insert_word(Word(20, 2 * i, H, "leaf")));
+            expected.insert_word(Word(20, 2 * i, H, "leaf"));
+            if (i == 5)
+                assert(grown.erase_word({0, 2}, H));
+        }
+        for (cord_t i = 0; i < forks.size(); i++)
+            assert(forks[i].word_count() == dim_t(200 + i - (i > 5), 0));
+        assert(grown.words_in(RectArea({0, 0}, {0, 0}))[0] == bottom);
+        CROSSWORD_DIM_ASSERTS(grown, dim_t(24, 399), dim_t(223, 0));
+        assert(render(grown) == render(expected));
+        CROSSWORD_DIM_ASSERTS(large, dim_t(6, 399), dim_t(200, 0));
+    }
+
+    void range_query_tests() {
+        // Rectangles crossing each other without sharing a corner.
+        RectArea row({0, 5}, {20, 5});
+        RECT_AREA_BASE_ASSERTS((row * RectArea({5, 0}, {10, 10})),
+                               pos_t(5, 5), pos_t(10, 5), dim_t(6, 1), false);
+        assert((row * RectArea({21, 0}, {30, 10})).empty());
+
+        using key_t = std::pair<pos_t, orientation_t>;
+        auto query = [](const Crossword &cr, const RectArea &rect) {
+            std::set<key_t> found;
+            cr.for_each_word_in(rect, [&found](const Word &w) {
+                assert(found.insert({w.get_start_position(), w.get_orientation()})
+                           .second);
+            });
+            assert(cr.words_in(rect).size() == found.size());
+            return found;
+        };
+        for (unsigned seed = 0; seed < 20; seed++) {
+            std::vector<Word> words = random_words(80, 3, 30, seed);
+            Crossword checked(words[0], {});
+            Crossword unchecked = checked;
+            std::vector<Word> accepted = {words[0]};
+            for (const Word &w : words) {
+                if (checked.insert_word(w) && w != words[0])
+                    accepted.push_back(w);
+                unchecked.insert_word(w, false);
+            }
+
+            for (unsigned i = 0; i < 30; i++) {
+                cord_t x = (seed * 7 + i * 13) % 36, y = (seed * 5 + i * 11) % 36;
+                RectArea rect({x, y}, {x + i % 9, y + i % 6});
+                // Of the words sharing a start, only the first one is kept.
+                std::set<key_t> expected, expected_unchecked, seen;
+                for (const Word &w : words) {
+                    key_t key = {w.get_start_position(), w.get_orientation()};
+                    if (seen.insert(key).second && !(w.rect_area() * rect).empty())
+                        expected_unchecked.insert(key);
+                }
+                for (const Word &w : accepted) {
+                    if (!(w.rect_area() * rect).empty())
+                        expected.insert({w.get_start_position(), w.get_orientation()});
+                }
+                assert(query(checked, rect) == expected);
+                assert(query(unchecked, rect) == expected_unchecked);
+            }
+        }
+
+        Crossword shared(Word(0, 4, H, "longword"), {});
+        Crossword fork = shared;
+        assert(fork.insert_word(Word(2, 0, V, "abc")));
+        assert(query(fork, RectArea({2, 2}, {3, 4})).size() == 2);
+        assert(query(shared, RectArea({2, 2}, {3, 4})).size() == 1);
+        assert(query(fork, DEFAULT_EMPTY_RECT_AREA).empty());
+    }
+
+    void file_tests() {
+        std::vector<Word> words = random_words(200, 3, 40, 11);
+        words.emplace_back(0, 50, H, "a word much longer than sixteen letters");
+        Crossword cr(words[0], {});
+        cr.insert_words(words);
+        Crossword fork = cr;
+        fork.insert_word(Word(60, 60, V, "layer"));
+        fork.insert_word(Word(70, 60, H, "cross"));
+        fork.insert_word(Word(72, 60, V, "over"));
+
+        std::stringstream saved;
+        fork.save(saved);
+        std::optional<Crossword> loaded = Crossword::load(saved);
+        assert(loaded.has_value());
+        CROSSWORD_DIM_ASSERTS((*loaded), fork.size(), fork.word_count());
+        assert(render(*loaded) == render(fork));
+
+        const char *path = "crosswords_tests.bin";
+        {
+            std::ofstream out(path, std::ios::binary);
+            fork.save(out);
+        }
+        std::optional<CrosswordView> view = CrosswordView::map(path);
+        assert(view.has_value());
+        assert(view->size() == fork.size() && view->word_count() == fork.word_count());
+        assert(view->letter_at({0, 50}) == 'A' && view->letter_at({9, 50}) == 'C');
+        assert(view->letter_at({60, 64}) == 'R' && !view->letter_at({60, 65}));
+        assert(render(view->to_crossword()) == render(fork));
+
+        // A collision planted in a checked crossword fails the rebuild, but
+        // a crossword saved unchecked is taken as it is.
+        std::string bytes = saved.str();
+        bytes[bytes.rfind("OVER")] = 'Q';
+        std::istringstream damaged(bytes);
+        assert(!Crossword::load(damaged).has_value());
+        std::istringstream truncated(bytes.substr(0, 100));
+        assert(!Crossword::load(truncated).has_value());
+
+        // BZ is accepted only once AB is there to cross KA and BZ, so the
+        // words are loaded in the order they were inserted in.
+        Crossword ordered(Word(2, 0, V, "ab"), {Word(1, 0, H, "ka"),
+                                                Word(2, 1, H, "bz")});
+        assert(ordered.word_count() == dim_t(2, 1));
+        std::stringstream saved_ordered;
+        ordered.save(saved_ordered);
+        loaded = Crossword::load(saved_ordered);
+        assert(loaded.has_value() && render(*loaded) == render(ordered));
+
+        Crossword unchecked(Word(0, 0, H, "abc"), {});
+        unchecked.insert_word(Word(1, 0, V, "xyz"), false);
+        std::stringstream saved_unchecked;
+        unchecked.save(saved_unchecked);
+        loaded = Crossword::load(saved_unchecked);
+        assert(loaded.has_value() && render(*loaded) == render(unchecked));
+
+        // The header's flags start at byte 16, its area at byte 24. Neither
+        // is taken on trust once the words are read.
+        std::string planted = saved_unchecked.str();
+        planted[16] = 1;
+        std::istringstream planted_in(planted);
+        assert(!Crossword::load(planted_in).has_value());
+        std::string widened = saved.str();
+        widened[24 + 2 * 8]++;
+        std::istringstream widened_in(widened);
+        assert(!Crossword::load(widened_in).has_value());
+        auto map_bytes = [path](const std::string &bytes) {
+            {
+                std::ofstream out(path, std::ios::binary);
+                out << bytes;
+            }
+            return CrosswordView::map(path);
+        };
+        std::optional<CrosswordView> wide = map_bytes(widened);
+        assert(wide->size() ==
+               dim_t(fork.size().first + 1, fork.size().second));
+        assert(wide->to_crossword().size() == fork.size());
+        assert(render(map_bytes(planted)->to_crossword()) == render(unchecked));
+
+        // A repeat longer than the stored word widens the loaded crossword.
+        Crossword repeated(Word(0, 0, H, "abc"), {});
+        repeated.insert_word(Word(0, 0, H, "abcde"), false);
+        assert(repeated.size() == dim_t(5, 1));
+        std::stringstream saved_repeated;
+        repeated.save(saved_repeated);
+        loaded = Crossword::load(saved_repeated);
+        assert(loaded.has_value() && loaded->size() == dim_t(5, 1));
+
+        {
+            std::ofstream out(path, std::ios::binary);
+            out << "not a crossword";
+        }
+        assert(!CrosswordView::map(path).has_value());
+        std::remove(path);
+        assert(!CrosswordView::map(path).has_value());
+    }
+
+    void import_tests() {
+        Crossword cr(Word(0, 0, H, "start"), {});
+        ImportResult result = cr.import_words("1 0 v tide\r\n"
+                                              "\n"
+                                              "  4 0\tV  tar  \n"
+                                              "2 0 V xx\n"
+                                              "0 5 H Left word");
+        assert(result.lines == 5 && result.error.empty());
+        assert(result.rejected == std::vector<size_t>({4}));
+        assert(render(cr) == render(Crossword(Word(0, 0, H, "START"),
+                                              {Word(1, 0, V, "TIDE"),
+                                               Word(4, 0, V, "TAR"),
+                                               Word(0, 5, H, "LEFT WORD")})));
+
+        std::istringstream bad("9 9 H ok\n10 x H no\n20 20 H never\n");
+        result = cr.import_words(bad);
+        assert(result.error_line == 2 && !result.error.empty());
+        assert(cr.word_count() == dim_t(3, 2));
+        assert(cr.import_words("1 2 D word").error_line == 1);
+        assert(cr.import_words("1 2 H").error_line == 1);
+        assert(cr.import_words("18446744073709551615 0 H ab").error_line == 1);
+        assert(cr.import_file("no such file").error_line == 0);
+
+        // Errors reading a stream, thrown or not, end up in the result, and
+        // the stream is left as an extraction would leave it.
+        result = cr.import_file("/tmp");
+        assert(!result.error.empty() && result.error_line == 0);
+        std::ifstream directory("/tmp");
+        directory.exceptions(std::ios::badbit);
+        result = cr.import_words(directory);
+        assert(!result.error.empty() && result.error_line == 0);
+        std::istringstream failed("7 7 H no\n");
+        failed.setstate(std::ios::failbit);
+        result = cr.import_words(failed);
+        assert(!result.error.empty() && result.error_line == 0 &&
+               result.lines == 0);
+        std::istringstream whole("30 30 H end\n");
+        whole.exceptions(std::ios::failbit);
+        result = cr.import_words(whole);
+        assert(result.error.empty() && result.lines == 1);
+        assert(whole.eof() && whole.fail());
+
+        // The stream goes on right after a malformed line.
+        std::istringstream partial("1 1 H ab\nbad line\n5 5 H cd\n");
+        Crossword empty(Word(0, 20, H, "away"), {});
+        result = empty.import_words(partial);
+        assert(result.error_line == 2 && partial.fail() && !partial.eof());
+        partial.clear();
+        std::string rest;
+        assert(std::getline(partial, rest) && rest == "5 5 H cd");
+
+        // Lines spanning chunks, and one longer than a chunk, import the
+        // same as words inserted one by one.
+        std::vector<Word> words = random_words(20000, 0, 1000, 5);
+        std::string text;
+        for (const Word &w : words) {
+            text += std::to_string(w.get_start_position().first) + ' ' +
+                    std::to_string(w.get_start_position().second) +
+                    (w.get_orientation() == H ? " H " : " V ");
+            for (size_t i = 0; i < w.length(); i++)
+                text += w.at(i);
+            text += '\n';
+        }
+        text += "0 2000 H " + std::string(100000, 'z');
+        words.emplace_back(0, 2000, H, std::string(100000, 'z'));
+        Crossword imported(words[0], {});
+        Crossword inserted = imported;
+        std::istringstream stream(text);
+        result = imported.import_words(stream);
+        assert(result.lines == words.size() && result.error.empty());
+        assert(result.rejected.size() == inserted.insert_words(words).size());
+        assert(render(imported) == render(inserted));
+    }
+
+    void fill_tests() {
+        CrosswordFiller filler({"crossword", "word", "row", "cross", "sword",
+                                "rows", "words", "or", "so", "dos", "cod",
+                                "odd", "woods", "crow", "sow", "swords"});
+        Crossword start(Word(4, 4, H, "crossword"), {});
+        RectArea target({0, 0}, {15, 12});
+
+        for (size_t threads : {1, 3}) {
+            FillLimits limits;
+            limits.threads = threads;
+            limits.node_limit = 2000;
+            Crossword filled = filler.fill(start, target, limits);
+            const FillStats &stats = filler.stats();
+            assert(stats.nodes > 0 && stats.nodes <= 2000 + threads);
+            assert(stats.words >= 4);
+
+            // Every word fits the target, the stats count the cells covered
+            // and a load checking all the words again accepts them.
+            std::vector<const Word *> words = filled.words_in(target);
+            assert(words.size() == stats.words + 1);
+            std::set<pos_t> cells;
+            for (const Word *w : words) {
+                assert((w->rect_area() * target).size() == w->rect_area().size());
+                for (size_t i = 0; i < w->length(); i++)
+                    cells.insert(w->get_orientation() == H
+                        ? pos_t(w->get_start_position().first + i,
+                                w->get_start_position().second)
+                        : pos_t(w->get_start_position().first,
+                                w->get_start_position().second + i));
+            }
+            assert(cells.size() == stats.letters);
+            std::stringstream saved;
+            filled.save(saved);
+            std::optional<Crossword> rebuilt = Crossword::load(saved);
+            assert(rebuilt.has_value() && render(*rebuilt) == render(filled));
+        }
+
+        // A target holding nothing but the start leaves it as it is.
+        Crossword same = filler.fill(start, RectArea({4, 4}, {12, 4}));
+        assert(render(same) == render(start) && filler.stats().words == 0);
+    }
+
+    void dictionary_tests() {
+        // Enough words of one length for several chunks of bitsets.
+        std::vector<std::string> words = {"cat", "Cod", "dog", "", "crossword"};
+        uint32_t state = 7;
+        for (size_t i = 0; i < 3000; i++) {
+            std::string word;
+            for (size_t n = 0; n < 3 + i % 3; n++) {
+                state = state * 1103515245 + 12345;
+                word += static_cast<char>('a' + (state >> 16) % 6);
+            }
+            words.push_back(word);
+        }
+        Dictionary dictionary(words);
+        assert(dictionary.size() == words.size() - 1);
+
+        for (std::string pattern : {"C?D", "c?d", "???", "?A?", "Z??", "?????",
+                                    "A?B?C", "CROSSWORD", "CROSS????", "",
+                                    "??????????"}) {
+            std::vector<std::string> expected;
+            for (const std::string &w : words) {
+                std::string upper = w;
+                for (char &c : upper)
+                    c = static_cast<char>(std::toupper(c));
+                bool match = !w.empty() && w.size() == pattern.size();
+                for (size_t i = 0; match && i < w.size(); i++) {
+                    match = pattern[i] == DEFAULT_CHAR ||
+                            std::toupper(pattern[i]) == upper[i];
+                }
+                if (match)
+                    expected.push_back(upper);
+            }
+            std::vector<std::string_view> found = dictionary.matches(pattern);
+            assert(found.size() == expected.size());
+            assert(std::equal(found.begin(), found.end(), expected.begin()));
+            assert(dictionary.count(pattern) == expected.size());
+        }
+
+        // Patterns of slots on the board.
+        Crossword cr(Word(2, 1, H, "cat"), {Word(3, 1, V, "add")});
+        assert(cr.pattern_at({2, 1}, H, 3) == "CAT");
+        assert(cr.pattern_at({3, 0}, V, 5) == "?ADD?");
+        assert(cr.pattern_at({0, 3}, H, 5) == "???D?");
+        assert(dictionary.matches(cr.pattern_at({2, 1}, H, 3)) ==
+               std::vector<std::string_view>{"CAT"});
+    }
+
+    void stats_tests() {
+        Crossword cr(Word(0, 0, H, "word"), {});
+        // A copy sharing the words makes the next insertion start a new
+        // layer, with memory of its own.
+        Crossword shared = cr;
+        cr.reset_stats();
+        assert(cr.insert_word(Word(1, 0, V, "ore")));
+        assert(!cr.insert_word(Word(0, 1, H, "next")));
+        Crossword other(Word(10, 10, H, "far"), {});
+        cr += other;
+        render(cr);
+
+        CrosswordStats stats = cr.stats();
+#ifdef CROSSWORDS_STATS
+        assert(stats.words_inserted == 2 && stats.words_rejected == 1);
+        assert(stats.collision_checks >= 2 && stats.collisions == 1);
+        assert(stats.letter_lookups > 0 && stats.word_lookups > 0);
+        assert(stats.bytes_allocated > 0);
+        assert(stats.insert_time.count() > 0 && stats.merge_time.count() > 0 &&
+               stats.render_time.count() > 0);
+        // Copies count on their own.
+        Crossword copy = cr;
+        assert(copy.stats().words_inserted == 0);
+        cr.reset_stats();
+        stats = cr.stats();
+#endif
+        assert(stats.words_inserted == 0 && stats.collision_checks == 0 &&
+               stats.bytes_allocated == 0 && stats.render_time.count() == 0);
+    }
+
+    void erase_tests() {
+        Crossword cr(Word(0, 0, H, "word"), {Word(1, 0, V, "ore"),
+                                             Word(0, 5, H, "far")});
+        assert(!cr.erase_word({0, 1}, H));
+        assert(!cr.erase_word({0, 0}, V));
+        Crossword copy = cr;
+
+        // Letters of crossing words stay, the area shrinks to what is left.
+        assert(cr.erase_word({0, 0}, H));
+        assert(cr.pattern_at({0, 0}, H, 3) == "?O?");
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(3, 6), dim_t(1, 1));
+        assert(!cr.erase_word({0, 0}, H));
+        std::vector<const Word *> found = cr.words_in(RectArea({0, 5}, {0, 5}));
+        assert(found.size() == 1 && cr.erase_word(found[0]));
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(1, 3), dim_t(0, 1));
+        assert(cr.erase_word({1, 0}, V));
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(0, 0), dim_t(0, 0));
+
+        // Copies sharing the words are left as they were.
+        CROSSWORD_DIM_ASSERTS(copy, dim_t(4, 6), dim_t(2, 1));
+        assert(copy.pattern_at({0, 0}, H, 4) == "WORD");
+
+        // Words drawn from the indexes, past one of a shared layer erased
+        // above the area.
+        Crossword rows(Word(0, 0, H, "top"), {Word(0, 2, H, "mid"),
+                                              Word(0, 4, H, "low")});
+        Crossword lower = rows;
+        lower.set_render_cache_limit(0);
+        assert(lower.erase_word({0, 0}, H));
+        assert(render(lower) ==
+               render(Crossword(Word(0, 2, H, "mid"), {Word(0, 4, H, "low")})));
+
+        // A word goes back in where one was erased, and survives a reload.
+        assert(copy.erase_word({0, 5}, H));
+        assert(copy.insert_word(Word(0, 4, H, "far")));
+        CROSSWORD_DIM_ASSERTS(copy, dim_t(4, 5), dim_t(2, 1));
+        std::stringstream saved;
+        copy.save(saved);
+        std::optional<Crossword> loaded = Crossword::load(saved);
+        assert(loaded.has_value() && render(*loaded) == render(copy));
+        CROSSWORD_DIM_ASSERTS((*loaded), copy.size(), copy.word_count());
+
+        // A copy erases shared words in a layer of its own: the words left
+        // are still those of the shared layer.
+        Crossword fresh = copy;
+        const Word *ore = copy.words_in(RectArea({1, 1}, {1, 1}))[0];
+        assert(fresh.erase_word({0, 0}, H));
+        assert(fresh.words_in(RectArea({1, 1}, {1, 1}))[0] == ore);
+        assert(fresh.pattern_at({0, 0}, H, 4) == "?O??");
+        CROSSWORD_DIM_ASSERTS(fresh, dim_t(3, 5), dim_t(1, 1));
+        assert(copy.pattern_at({0, 0}, H, 4) == "WORD");
+        CROSSWORD_DIM_ASSERTS(copy, dim_t(4, 5), dim_t(2, 1));
+        assert(fresh.words_in(RectArea({0, 0}, {3, 0})).size() == 1);
+        assert(fresh.insert_word(Word(0, 0, H, "word")));
+        assert(render(fresh) == render(copy));
+
+        // Erasing a share of the words of a layered crossword leaves the
+        // same crossword as inserting only the others.
+        std::vector<Word> words = random_words(400, 3, 40, 17);
+        Crossword layered(words[0], {});
+        std::vector<Word> accepted = {words[0]}, kept;
+        std::set<std::pair<pos_t, orientation_t>> starts = {
+            {words[0].get_start_position(), words[0].get_orientation()}};
+        std::vector<Crossword> forks;
+        for (const Word &w : words) {
+            if (!starts.insert({w.get_start_position(), w.get_orientation()})
+                     .second ||
+                !layered.insert_word(w))
+                continue;
+            accepted.push_back(w);
+            if (accepted.size() % 20 == 0)
+                forks.push_back(layered);
+        }
+        for (size_t i = 0; i < accepted.size(); i++) {
+            const Word &w = accepted[i];
+            if (i % 3 == 0)
+                kept.push_back(w);
+            else
+                assert(layered.erase_word(w.get_start_position(),
+                                          w.get_orientation()));
+        }
+        Crossword rebuilt(kept[0], {});
+        for (const Word &w : kept)
+            rebuilt.insert_word(w, false);
+        CROSSWORD_DIM_ASSERTS(layered, rebuilt.size(), rebuilt.word_count());
+        assert(render(layered) == render(rebuilt));
+        assert(layered.words_in(RectArea({0, 0}, {50, 50})).size() ==
+               kept.size());
+    }
+
+    void checkpoint_tests() {
+        Crossword cr(Word(0, 0, H, "word"), {});
+        std::string before = render(cr);
+
+        Crossword::checkpoint_t outer = cr.checkpoint();
+        assert(cr.insert_word(Word(1, 0, V, "ore")));
+        Crossword::checkpoint_t inner = cr.checkpoint();
+        assert(cr.insert_word(Word(0, 2, H, "deep")));
+        assert(!cr.insert_word(Word(0, 3, H, "next")));
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(4, 3), dim_t(2, 1));
+        cr.rollback(inner);
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(4, 3), dim_t(1, 1));
+        assert(cr.pattern_at({0, 2}, H, 4) == "?E??");
+        // A closed checkpoint is ignored.
+        cr.rollback(inner);
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(4, 3), dim_t(1, 1));
+
+        // Committed changes of a nested checkpoint go with the outer one.
+        inner = cr.checkpoint();
+        assert(cr.insert_word(Word(3, 0, V, "dam")));
+        cr.commit(inner);
+        cr.rollback(outer);
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(4, 1), dim_t(1, 0));
+        assert(render(cr) == before);
+
+        // Unchecked letters overwritten are restored, and so is the flag of
+        // a checked crossword.
+        outer = cr.checkpoint();
+        assert(cr.insert_word(Word(1, 0, V, "axe"), false));
+        assert(cr.pattern_at({0, 0}, H, 4) == "WARD");
+        cr.rollback(outer);
+        assert(render(cr) == before);
+        assert(cr.insert_word(Word(1, 0, V, "ore")));
+        assert(!cr.insert_word(Word(0, 1, H, "rod")));
+
+        // Copies taken within a checkpoint keep their words.
+        outer = cr.checkpoint();
+        assert(cr.insert_word(Word(3, 0, V, "dam")));
+        Crossword copy = cr;
+        assert(cr.insert_word(Word(0, 4, H, "far")));
+        cr.rollback(outer);
+        CROSSWORD_DIM_ASSERTS(cr, dim_t(4, 3), dim_t(1, 1));
+        CROSSWORD_DIM_ASSERTS(copy, dim_t(4, 3), dim_t(1, 2));
+        std::stringstream saved;
+        cr.save(saved);
+        std::optional<Crossword> loaded = Crossword::load(saved);
+        assert(loaded.has_value() && render(*loaded) == render(cr));
+
+        // Words erased since the checkpoint stay erased, and the size goes
+        // with them.
+        Crossword far(Word(0, 0, H, "abc"), {Word(20, 20, H, "xy")});
+        Crossword::checkpoint_t token = far.checkpoint();
+        assert(far.insert_word(Word(0, 4, H, "def")));
+        assert(far.erase_word({20, 20}, H));
+        CROSSWORD_DIM_ASSERTS(far, dim_t(3, 5), dim_t(2, 0));
+        far.rollback(token);
+        CROSSWORD_DIM_ASSERTS(far, dim_t(3, 1), dim_t(1, 0));
+        assert(render(far) == render(Crossword(Word(0, 0, H, "abc"), {})));
+
+        // A depth-first search: every branch rolled back but the chosen one
+        // leaves the crossword built from the chosen words alone.
+        std::vector<Word> words = random_words(300, 3, 40, 23);
+        Crossword searched(words[0], {});
+        Crossword chosen(words[0], {});
+        std::vector<Crossword::checkpoint_t> path;
+        for (size_t i = 1; i < words.size(); i++) {
+            if (i % 7 == 0)
+                path.push_back(searched.checkpoint());
+            searched.insert_word(words[i]);
+            if (i % 7 == 6 && !path.empty()) {
+                if (i % 3 == 0)
+                    searched.commit(path.back());
+                else
+                    searched.rollback(path.back());
+                path.pop_back();
+            }
+            if (i % 50 == 0)
+                copy = searched;
+        }
+        for (size_t i = 1; i < words.size(); i++) {
+            if (i % 7 == 0 && (i + 6) % 3 != 0)
+                i += 6;
+            else
+                chosen.insert_word(words[i]);
+        }
+        CROSSWORD_DIM_ASSERTS(searched, chosen.size(), chosen.word_count());
+        assert(render(searched) == render(chosen));
+    }
+
+    constexpr TemplateWord MINI_BOARD[] = {
+        {{0, 0}, H, "word"}, {{1, 0}, V, "ore"}, {{0, 2}, H, "deep"},
+        {{1, 0}, V, "ore"}, {{3, 0}, V, "dip"}};
+    constexpr TemplateWord CLASHING_BOARD[] = {
+        {{0, 0}, H, "word"}, {{1, 0}, V, "axe"}};
+    constexpr TemplateWord CRAMPED_BOARD[] = {
+        {{0, 0}, H, "word"}, {{0, 1}, H, "next"}};
+
+    static_assert(RectArea({2, 1}, {5, 3}).size() == dim_t(4, 3));
+    static_assert((RectArea({2, 1}, {5, 3}) * RectArea({6, 0}, {9, 9})).empty());
+    static_assert(Word::are_letters_the_same('?', ' ') &&
+                  !Word::are_letters_the_same('A', '?'));
+    static_assert(first_colliding(MINI_BOARD) == std::size(MINI_BOARD));
+    static_assert(first_colliding(CLASHING_BOARD) == 1);
+    static_assert(first_colliding(CRAMPED_BOARD) == 1);
+    static_assert(StaticCrossword<MINI_BOARD>::size() == dim_t(4, 3));
+    static_assert(StaticCrossword<MINI_BOARD>::word_count() == dim_t(2, 2));
+
+    void static_crossword_tests() {
+        CrosswordView view = StaticCrossword<MINI_BOARD>::view();
+        CROSSWORD_DIM_ASSERTS(view, dim_t(4, 3), dim_t(2, 2));
+        assert(view.letter_at({1, 1}) == 'R' && view.letter_at({3, 2}) == 'P');
+        assert(!view.letter_at({0, 1}).has_value());
+
+        Crossword built(Word(0, 0, H, "word"), {});
+        assert(built.insert_words(std::vector<Word>{
+                   Word(1, 0, V, "ore"), Word(0, 2, H, "deep"),
+                   Word(3, 0, V, "dip")}).empty());
+        Crossword copy = view.to_crossword();
+        CROSSWORD_DIM_ASSERTS(copy, built.size(), built.word_count());
+        assert(render(copy) == render(built));
+        // The words of the template are known to fit together.
+        assert(!copy.insert_word(Word(2, 0, V, "rim")));
+    }
+
+    void line_check_tests() {
+        // Long words are checked a tile line at a time: the verdicts match
+        // the rules applied a letter at a time over a plain grid.
+        std::map<pos_t, char> grid;
+        std::vector<Word> stored;
+        Crossword cr(Word(0, 0, H, "a"), {});
+        grid[{0, 0}] = 'A';
+        stored.push_back(Word(0, 0, H, "a"));
+        std::vector<Crossword> forks;
+        unsigned seed = 29;
+        auto next = [&seed](unsigned bound) {
+            seed = seed * 1103515245 + 12345;
+            return (seed >> 8) % bound;
+        };
+        for (size_t n = 0; n < 3000; n++) {
+            std::string letters(1 + next(40), ' ');
+            for (char &c : letters)
+                c = "aab?  "[next(6)];
+            Word w(next(60), next(60), next(2) ? H : V, std::move(letters));
+            bool collides = collides_with_letters(w, [&grid](pos_t pos) {
+                auto it = grid.find(pos);
+                return it == grid.end() ? std::optional<char>()
+                                        : std::optional<char>(it->second);
+            });
+            for (const Word &other : stored) {
+                if (other.get_orientation() == w.get_orientation() &&
+                    (other.get_start_position() != w.get_start_position() ||
+                     other.length() != w.length()) &&
+                    !(other.rect_area() * w.rect_area()).empty())
+                    collides = true;
+            }
+            assert(cr.insert_word(w) == !collides);
+            if (collides)
+                continue;
+            stored.push_back(w);
+            for (size_t i = 0; i < w.length(); i++)
+                grid.emplace(w.pos_of_letter(i), w.at(i));
+            if (n % 100 == 0)
+                forks.push_back(cr);
+        }
+        assert(stored.size() > 100);
+    }
+
+    // The cells of window cut out of the full rendering of a crossword whose
+    // area starts at (0, 0).
+    std::string cut_out(const Crossword &cr, const RectArea &window) {
+        std::string full = render(cr);
+        size_t full_row = 2 * cr.size().first + 4;
+        size_t row_size = 2 * window.size().first + 4;
+        std::string cut;
+        for (size_t row = 0; row < window.size().second + 2; row++) {
+            for (size_t i = 0; i < row_size; i++)
+                cut += i % 2 ? ' ' : CROSSWORD_BACKGROUND;
+            cut.back() = '\n';
+        }
+        if (window.empty())
+            return cut;
+        pos_t lt = window.get_left_top();
+        for (size_t dy = 0; dy < window.size().second; dy++) {
+            for (size_t dx = 0; dx < window.size().first; dx++) {
+                cord_t x = lt.first + dx, y = lt.second + dy;
+                if (x < cr.size().first && y < cr.size().second)
+                    cut[(dy + 1) * row_size + 2 * dx + 2] =
+                        full[(y + 1) * full_row + 2 * x + 2];
+            }
+        }
+        return cut;
+    }
+
+    void window_tests() {
+        Crossword cr(Word(0, 0, H, "a"), {});
+        cr.insert_words(random_words(150, 2, 50, 31));
+        // Letters of the shared layer show through the new one.
+        Crossword shared = cr;
+        cr.insert_words(random_words(150, 2, 50, 37));
+        std::ostringstream out;
+        cr.render(out, RectArea({0, 0}, {MAX_COORDINATE, MAX_COORDINATE}));
+        assert(out.str() == render(cr));
+
+        unsigned seed = 7;
+        for (size_t n = 0; n < 200; n++) {
+            seed = seed * 1103515245 + 12345;
+            cord_t x = (seed >> 8) % 60, y = (seed >> 16) % 60;
+            RectArea window({x, y},
+                            {x + (seed >> 4) % 20, y + (seed >> 12) % 12});
+            std::ostringstream unclipped;
+            cr.render(unclipped, window, false);
+            assert(unclipped.str() == cut_out(cr, window));
+
+            RectArea clipped = window * RectArea({0, 0}, {cr.size().first - 1,
+                                                          cr.size().second - 1});
+            std::string buffer(cut_out(cr, clipped).size(), '\0');
+            assert(cr.render(window, buffer.data(), buffer.size() - 1) ==
+                   buffer.size());
+            assert(buffer == std::string(buffer.size(), '\0'));
+            assert(cr.render(window, buffer.data(), buffer.size()) ==
+                   buffer.size());
+            assert(buffer == cut_out(cr, clipped));
+        }
+
+        // A window off the board clips to nothing but the border.
+        std::ostringstream off;
+        cr.render(off, RectArea({500, 500}, {600, 600}));
+        assert(off.str() == cut_out(cr, DEFAULT_EMPTY_RECT_AREA));
+
+        // Words inserted unchecked are drawn as operator<< draws them, even
+        // where their letters disagree with the cells.
+        Crossword unchecked(Word(0, 1, H, "abc"), {});
+        unchecked.insert_word(Word(1, 0, V, "xyz"), false);
+        std::ostringstream crossed;
+        unchecked.render(crossed, RectArea({1, 1}, {1, 1}));
+        assert(crossed.str() == ". . .\n. B .\n. . .\n");
+        // Bytes outside ASCII are not letters, whichever way they are drawn.
+        Crossword accented(Word(0, 0, H, "a\xc3\xa9z"), {});
+        std::ostringstream cells;
+        accented.render(cells, RectArea({0, 0}, {3, 0}));
+        assert(cells.str() == ". . . . . .\n. A ? ? Z .\n. . . . . .\n");
+        accented.insert_word(Word(1, 0, V, "\xc3\xa9"), false);
+        std::ostringstream words;
+        accented.render(words, RectArea({0, 0}, {3, 1}));
+        assert(words.str() == ". . . . . .\n. A ? ? Z .\n. . ? . . .\n"
+                              ". . . . . .\n");
+        unchecked = cr;
+        for (const Word &w : random_words(150, 2, 50, 41))
+            unchecked.insert_word(w, false);
+        for (size_t n = 0; n < 100; n++) {
+            seed = seed * 1103515245 + 12345;
+            cord_t x = (seed >> 8) % 60, y = (seed >> 16) % 60;
+            RectArea window({x, y},
+                            {x + (seed >> 4) % 20, y + (seed >> 12) % 12});
+            std::ostringstream unclipped;
+            unchecked.render(unclipped, window, false);
+            assert(unclipped.str() == cut_out(unchecked, window));
+        }
+    }
+
+    // Keeps nothing of what is written to it.
+    class NullBuffer : public std::streambuf {
+        protected:
+            int_type overflow(int_type c) override { return c; }
+            std::streamsize xsputn(const char *, std::streamsize n) override {
+                return n;
+            }
+    };
+
+    // Batch b adds BATCH words on row 2 * b + 2, so a reader sees whole
+    // batches or none.
+    void concurrent_tests() {
+        constexpr size_t BATCH = 20, BATCHES = 40;
+        ConcurrentCrossword cc(Crossword(Word(0, 0, H, "start"), {}));
+        std::atomic<bool> done{false};
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 3; t++) {
+            readers.emplace_back([&cc, &done] {
+                ConcurrentCrossword::Reader reader = *cc.reader();
+                size_t seen = 1;
+                bool last = false;
+                while (!last) {
+                    last = done.load();
+                    ConcurrentCrossword::Snapshot s = *reader.read();
+                    size_t total = s->word_count().first;
+                    assert(total >= seen && (total - 1) % BATCH == 0);
+                    seen = total;
+                    RectArea all({0, 0}, {s->size().first - 1,
+                                          s->size().second - 1});
+                    assert(s->words_in(all).size() == total);
+                    assert(s->size().second == 1 + 2 * (total - 1) / BATCH);
+                    // Readers of a version share its render cache.
+                    std::ostringstream os;
+                    s->render(os, all);
+                    os << *s;
+                }
+                assert(seen == 1 + BATCH * BATCHES);
+            });
+        }
+        for (size_t b = 0; b < BATCHES; b++) {
+            for (size_t i = 0; i < BATCH; i++)
+                assert(cc.draft().insert_word(
+                    Word(i * 4, 2 * b + 2, H, "abc")));
+            cc.publish();
+        }
+        done = true;
+        for (std::thread &t : readers)
+            t.join();
+        cc.publish();
+        assert(cc.unreclaimed() == 0);
+
+        // A snapshot keeps its version through later publications.
+        ConcurrentCrossword::Reader reader = *cc.reader();
+        {
+            ConcurrentCrossword::Snapshot s = *reader.read();
+            std::string before = render(*s);
+            // A reader holds one snapshot at a time.
+            assert(!reader.read().has_value());
+            cc.draft().insert_word(Word(0, 100, H, "later"));
+            cc.publish();
+            cc.publish();
+            assert(cc.unreclaimed() == 2);
+            assert(render(*s) == before);
+            assert(s->word_count().first == 1 + BATCH * BATCHES);
+        }
+        cc.publish();
+        assert(cc.unreclaimed() == 0);
+        assert(render(**reader.read()) == render(cc.draft()));
+
+        // A fresh version is printed from the rendering made when it was
+        // published.
+        cc.draft().insert_word(Word(8, 100, H, "fresh"));
+        cc.publish();
+        {
+            ConcurrentCrossword::Snapshot s = *reader.read();
+            NullBuffer null;
+            std::ostream out(&null);
+            size_t before = allocations;
+            out << *s;
+            assert(allocations == before);
+            assert(render(*s) == render(cc.draft()));
+        }
+
+        // Slots run out and are handed out again.
+        std::vector<ConcurrentCrossword::Reader> taken;
+        while (std::optional<ConcurrentCrossword::Reader> r = cc.reader())
+            taken.push_back(std::move(*r));
+        assert(taken.size() == cc.max_readers() - 1);
+        taken.pop_back();
+        assert(cc.reader().has_value());
+        ConcurrentCrossword few(Crossword(Word(0, 0, H, "few"), {}), 2);
+        std::optional<ConcurrentCrossword::Reader> first = few.reader();
+        std::optional<ConcurrentCrossword::Reader> second = few.reader();
+        assert(first.has_value() && second.has_value());
+        assert(few.max_readers() == 2 && !few.reader().has_value());
+    }
+
+    // Small shards, so that many words reach into several of them.
+    void sharded_tests() {
+        std::vector<Word> words = random_words(3000, 0, 150, 11);
+        words.emplace_back(10, 70, H, "crossingmanyshardsatonce");
+        words.emplace_back(31, 0, V, "downalongashardborderline");
+        Crossword sequential(words[0], {});
+        std::vector<size_t> expected = sequential.insert_words(words);
+
+        for (cord_t side : {2, 16, 33, 1024}) {
+            for (size_t threads : {1, 2, 4}) {
+                ShardedCrossword sharded(side);
+                std::vector<size_t> rejected = sharded.insert_words(
+                    std::span<const Word>(words).first(1000), threads);
+                std::vector<size_t> more = sharded.insert_words(
+                    std::span<const Word>(words).subspan(1000), threads);
+                for (size_t i : more)
+                    rejected.push_back(i + 1000);
+                assert(rejected == expected);
+                assert(sharded.word_count() == sequential.word_count());
+                assert(sharded.size() == sequential.size());
+                std::string row = sequential.pattern_at({0, 70}, H, 160);
+                for (cord_t x = 0; x < row.size(); x++)
+                    assert(sharded.letter_at({x, 70}).value_or(DEFAULT_CHAR) ==
+                           row[x]);
+                assert(!sharded.letter_at({500, 500}).has_value());
+                assert(render(sharded.to_crossword()) == render(sequential));
+            }
+        }
+
+        ShardedCrossword empty;
+        assert(empty.insert_words({}, 4).empty());
+        assert(empty.word_count() == dim_t(0, 0) && empty.shard_count() == 0);
+
+        // Shards of one cell, up to the edge of the space.
+        const cord_t M = MAX_COORDINATE;
+        std::vector<Word> edge = {Word(M - 1, M - 1, H, "ab"),
+                                  Word(M, M - 2, V, "xbz"),
+                                  Word(M - 2, M, H, "no")};
+        ShardedCrossword cells(1);
+        assert(cells.insert_words(edge, 2) == std::vector<size_t>{2});
+        assert(cells.letter_at({M, M}) == 'Z');
+        assert(cells.word_count() == dim_t(1, 1));
+        assert(cells.size() == dim_t(2, 3));
+
+        bool thrown = false;
+        try {
+            ShardedCrossword none(0);
+        } catch (const std::invalid_argument &) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+
+    std::string uncached(const Crossword &cr) {
+        Crossword copy = cr;
+        copy.set_render_cache_limit(0);
+        return render(copy);
+    }
+
+    void render_cache_tests() {
+        Crossword cr(Word(10, 10, H, "cached"), {});
+        assert(render(cr) == uncached(cr));
+
+        // Words within the area, then ones growing it every way.
+        for (const Word &w : {Word(12, 9, V, "acta"), Word(10, 12, H, "stay"),
+                              Word(17, 8, V, "rows"), Word(10, 14, H, "tail"),
+                              Word(9, 18, V, "down"), Word(13, 2, V, "upper"),
+                              Word(1, 16, H, "wider"),
+                              Word(20, 4, H, "right")}) {
+            assert(cr.insert_word(w));
+            assert(render(cr) == uncached(cr));
+        }
+        assert(cr.erase_word({9, 18}, V));
+        assert(render(cr) == uncached(cr));
+        assert(cr.erase_word({13, 2}, V));
+        assert(render(cr) == uncached(cr));
+
+        Crossword::checkpoint_t token = cr.checkpoint();
+        assert(cr.insert_word(Word(0, 30, H, "gone")));
+        assert(cr.insert_word(Word(20, 14, H, "soon")));
+        assert(render(cr) == uncached(cr));
+        cr.rollback(token);
+        assert(render(cr) == uncached(cr));
+
+        // Layers flattened under the cache render the same.
+        std::vector<Crossword> copies;
+        for (cord_t y = 40; y < 80; y += 2) {
+            copies.push_back(cr);
+            assert(cr.insert_word(Word(0, y, H, "layer")));
+        }
+        assert(render(cr) == uncached(cr));
+
+        CROSSWORD_BACKGROUND = '#';
+        assert(render(cr) == uncached(cr));
+        assert(render(cr).find('.') == std::string::npos);
+        CROSSWORD_BACKGROUND = '.';
+        assert(render(cr) == uncached(cr));
+
+#ifdef CROSSWORDS_STATS
+        // Only the rows of a new word are rendered again.
+        render(cr);
+        Crossword fresh = cr;
+        render(fresh);
+        uint64_t whole = fresh.stats().letter_lookups;
+        cr.reset_stats();
+        render(cr);
+        assert(cr.stats().letter_lookups == 0);
+        assert(cr.insert_word(Word(10, 60, H, "one")));
+        cr.reset_stats();
+        render(cr);
+        assert(cr.stats().letter_lookups > 0 &&
+               cr.stats().letter_lookups * 10 < whole);
+#endif
+
+        // Too large for the cache, or unchecked.
+        cr.set_render_cache_limit(100);
+        assert(cr.insert_word(Word(10, 64, H, "two")));
+        assert(render(cr) == uncached(cr));
+        cr.set_render_cache_limit(Crossword::DEFAULT_RENDER_CACHE_LIMIT);
+        render(cr);
+        cr.insert_word(Word(0, 40, V, "xx"), false);
+        assert(render(cr) == uncached(cr));
+        Crossword other(Word(0, 0, H, "other"), {});
+        cr = other;
+        assert(render(cr) == render(other));
+
+        // Bytes outside ASCII are drawn as the default char.
+        Crossword accented(Word(0, 0, H, "a\xc3\xa9z"), {});
+        assert(render(accented) == ". . . . . .\n. A ? ? Z .\n. . . . . .\n");
+        assert(render(accented) == uncached(accented));
+    }
+
+    // Letters, collision checks and rendering read a built crossword
+    // without taking any heap memory.
+    void allocation_tests() {
+        std::vector<Word> words = random_words(400, 0, 60, 3);
+        for (cord_t i = 0; i < 40; i++)
+            words.emplace_back(i * 3 % 50, i * 7 % 50, i % 2 ? H : V,
+                               "collisionchecked");
+        Crossword cr(words[0], {});
+        cr.insert_words(words);
+        std::vector<Word> stored, shifted;
+        cr.for_each_word_in(RectArea({0, 0}, {100, 100}), [&](const Word &w) {
+            stored.push_back(w);
+            pos_t start = w.get_start_position();
+            (w.get_orientation() == H ? start.first : start.second)++;
+            shifted.emplace_back(start.first, start.second,
+                                 w.get_orientation(), "abcdefghij");
+        });
+        assert(stored.size() > 50);
+        NullBuffer null;
+        std::ostream out(&null);
+        out << cr;
+        char buffer[4096];
+        dim_t count = cr.word_count();
+
+        size_t before = allocations;
+        for (cord_t y = 0; y < 70; y += 5) {
+            for (cord_t x = 0; x < 70; x += 5)
+                cr.pattern_at({x, y}, x % 2 ? H : V, 8);
+        }
+        // Stored words pass the checks again, shifted ones collide.
+        for (const Word &w : stored)
+            assert(cr.insert_word(w));
+        for (const Word &w : shifted)
+            assert(!cr.insert_word(w));
+        assert(!cr.erase_word({1000, 1000}, H));
+        size_t visited = 0;
+        cr.for_each_word_in(RectArea({10, 10}, {30, 30}),
+                            [&visited](const Word &) { visited++; });
+        for (cord_t y = 0; y < 60; y += 7)
+            cr.render(RectArea({y, y}, {y + 30, y + 20}), buffer,
+                      sizeof(buffer));
+        out << cr;
+        assert(allocations == before);
+        assert(cr.word_count() == count && visited > 0);
+
+        // Rows redone after an edit within the area are rendered in place.
+        RectArea bounds = stored[0].rect_area();
+        for (const Word &w : stored) {
+            bounds.embrace(w.get_start_position());
+            bounds.embrace(w.get_end_position());
+        }
+        pos_t lt = bounds.get_left_top(), rb = bounds.get_right_bottom();
+        auto inner = std::find_if(stored.begin(), stored.end(),
+                                  [&lt, &rb](const Word &w) {
+            pos_t start = w.get_start_position(), end = w.get_end_position();
+            return start.first > lt.first && start.second > lt.second &&
+                   end.first < rb.first && end.second < rb.second;
+        });
+        assert(inner != stored.end() && cr.erase_word(&*inner));
+        before = allocations;
+        out << cr;
+        assert(allocations == before);
+    }
+
+    // Checks the recorded crossings, degrees and components against ones
+    // found by looking up the words at each cell.
+    void check_crossings(const Crossword &cr) {
+        std::vector<const Word *> words =
+            cr.words_in(RectArea({0, 0}, {200, 200}));
+        std::map<const Word *, std::set<std::pair<const Word *, pos_t>>> found;
+        size_t crossings = 0;
+        for (const Word *w : words) {
+            auto &crossed = found[w];
+            for (size_t i = 0; i < w->length(); i++) {
+                pos_t cell = w->pos_of_letter(i);
+                for (const Word *c : cr.words_in(RectArea(cell, cell))) {
+                    if (c->get_orientation() != w->get_orientation())
+                        crossed.insert({c, cell});
+                }
+            }
+            std::vector<Crossword::Crossing> recorded = cr.crossings_of(w);
+            std::set<std::pair<const Word *, pos_t>> listed;
+            for (const Crossword::Crossing &c : recorded)
+                listed.insert({c.word, c.cell});
+            assert(listed == crossed && recorded.size() == crossed.size());
+            assert(cr.degree(w) == crossed.size());
+            crossings += crossed.size();
+        }
+        assert(cr.crossing_count() * 2 == crossings);
+
+        std::vector<size_t> counts(1, 0);
+        for (const Word *w : words) {
+            if (found[w].size() >= counts.size())
+                counts.resize(found[w].size() + 1);
+            counts[found[w].size()]++;
+        }
+        assert(cr.degree_counts() == counts);
+
+        std::map<const Word *, size_t> component;
+        size_t components = 0;
+        for (const Word *w : words) {
+            if (component.contains(w))
+                continue;
+            std::vector<const Word *> pending = {w}, members;
+            component[w] = components;
+            while (!pending.empty()) {
+                const Word *next = pending.back();
+                pending.pop_back();
+                members.push_back(next);
+                for (const auto &[c, cell] : found[next]) {
+                    if (component.try_emplace(c, components).second)
+                        pending.push_back(c);
+                }
+            }
+            for (const Word *m : members) {
+                assert(cr.component_size(m) == members.size());
+                assert(cr.connected(m, w));
+            }
+            if (components > 0)
+                assert(!cr.connected(w, words[0]));
+            components++;
+        }
+        assert(cr.component_count() == components);
+    }
+
+    void crossing_tests() {
+        Crossword cr(Word(0, 0, H, "word"), {Word(1, 0, V, "ore"),
+                                             Word(0, 2, H, "deep"),
+                                             Word(0, 5, H, "far")});
+        const Word *ore = cr.words_in(RectArea({1, 1}, {1, 1}))[0];
+        const Word *word = cr.words_in(RectArea({3, 0}, {3, 0}))[0];
+        const Word *far = cr.words_in(RectArea({0, 5}, {0, 5}))[0];
+        assert(cr.degree(ore) == 2 && cr.degree(word) == 1);
+        std::vector<Crossword::Crossing> crossed = cr.crossings_of(word);
+        assert(crossed.size() == 1 && crossed[0].word == ore &&
+               crossed[0].cell == pos_t(1, 0));
+        assert(cr.crossing_count() == 2 && cr.component_count() == 2);
+        assert(cr.connected(word, ore) && !cr.connected(word, far));
+        assert(cr.component_size(word) == 3 && cr.component_size(far) == 1);
+        assert(cr.degree_counts() == std::vector<size_t>({1, 2, 1}));
+        check_crossings(cr);
+
+        // Copies share the crossings found so far, and erasing the word
+        // joining the others takes them apart.
+        Crossword copy = cr;
+        assert(cr.erase_word(ore));
+        assert(cr.crossing_count() == 0 && cr.component_count() == 3);
+        assert(cr.degree_counts() == std::vector<size_t>({3}));
+        check_crossings(cr);
+        check_crossings(copy);
+        assert(copy.insert_word(Word(2, 2, V, "ever")));
+        assert(copy.component_count() == 1);
+        check_crossings(copy);
+
+        // Unions made before a crossed word is erased are not undone one by
+        // one, as the erasure took their components apart.
+        Crossword searched(Word(0, 0, H, "word"), {});
+        Crossword::checkpoint_t token = searched.checkpoint();
+        assert(searched.insert_word(Word(1, 0, V, "ore")));
+        assert(searched.insert_word(Word(0, 2, H, "deep")));
+        assert(searched.erase_word({0, 0}, H));
+        assert(searched.component_count() == 1);
+        searched.rollback(token);
+        assert(searched.component_count() == 0);
+        check_crossings(searched);
+
+        // Inserts into layered copies, erasures and rollbacks, with and
+        // without erasures in between.
+        std::vector<Word> words = random_words(600, 3, 40, 31);
+        Crossword built(words[0], {});
+        std::vector<Crossword> forks;
+        std::vector<Crossword::checkpoint_t> path;
+        for (size_t i = 1; i < words.size(); i++) {
+            if (i % 11 == 0)
+                path.push_back(built.checkpoint());
+            built.insert_word(words[i]);
+            if (i % 40 == 0)
+                forks.push_back(built);
+            if (i % 13 == 0) {
+                std::vector<const Word *> near = built.words_in(
+                    RectArea(words[i].get_start_position(),
+                             words[i].get_end_position()));
+                if (!near.empty())
+                    built.erase_word(near[0]);
+            }
+            if (i % 11 == 10 && !path.empty()) {
+                if (i % 3 == 0)
+                    built.commit(path.back());
+                else
+                    built.rollback(path.back());
+                path.pop_back();
+            }
+            if (i % 25 == 0)
+                check_crossings(built);
+        }
+        check_crossings(built);
+        for (const Crossword &fork : forks)
+            check_crossings(fork);
+        token = built.checkpoint();
+        for (size_t i = 0; i < 100; i++)
+            built.insert_word(words[i], i % 5 == 0);
+        check_crossings(built);
+        built.rollback(token);
+        check_crossings(built);
+        std::stringstream saved;
+        built.save(saved);
+        std::optional<Crossword> loaded = Crossword::load(saved);
+        assert(loaded.has_value());
+        assert(loaded->crossing_count() == built.crossing_count());
+        assert(loaded->component_count() == built.component_count());
+        assert(loaded->degree_counts() == built.degree_counts());
+    }
+
+    // The replaced operator new and delete all go through this pair. Kept
+    // out of line, so that the compiler matches each delete with the
+    // operator new it saw rather than with the free inside.
+    [[gnu::noinline]] void *counted_alloc(size_t size, size_t align) {
+        allocations++;
+        if (align <= alignof(std::max_align_t))
+            return std::malloc(size ? size : 1);
+        return std::aligned_alloc(align, (size + align - 1) / align * align);
+    }
+
+    [[gnu::noinline]] void counted_free(void *ptr) noexcept { std::free(ptr); }
 }   /* anonymous namespace */
 
+void *operator new(size_t size) {
+    if (void *ptr = counted_alloc(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    if (void *ptr = counted_alloc(size, static_cast<size_t>(alignment)))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return counted_alloc(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void *ptr) noexcept { counted_free(ptr); }
+
+void operator delete(void *ptr, size_t) noexcept { counted_free(ptr); }
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    counted_free(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+    counted_free(ptr);
+}
+
 int main() {
     crossword_tests();
+    storage_tests();
+    cell_index_tests();
+    render_tests();
+    bulk_insert_tests();
+    merge_tests();
+    sharing_tests();
+    range_query_tests();
+    file_tests();
+    import_tests();
+    fill_tests();
+    dictionary_tests();
+    stats_tests();
+    erase_tests();
+    checkpoint_tests();
+    static_crossword_tests();
+    line_check_tests();
+    window_tests();
+    concurrent_tests();
+    sharded_tests();
+    render_cache_tests();
+    allocation_tests();
+    crossing_tests();
 }